@@ -1,11 +1,15 @@
+#include "../src/image.hpp"
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <vector>
 
 typedef struct BitmapHeader_ {
     int isize;             /* 情報ヘッダサイズ */
     int width;             /* 幅 */
-    int height;            /* 高さ */
+    int height;            /* 高さ (負数: トップダウン) */
     unsigned short planes; /* プレーン数 */
     unsigned short bits;   /* 色ビット数 */
     unsigned int ctype;    /* 圧縮形式 */
@@ -16,106 +20,269 @@ typedef struct BitmapHeader_ {
     unsigned int inum;     /* 重要色数 */
 } BitmapHeader;
 
-int main(int argc, char* argv[])
+#define BI_RGB 0
+#define BI_BITFIELDS 3
+
+struct Image {
+    std::string name;
+    int width;
+    int height;
+    std::vector<uint32_t> palette; // RGBA8888
+    std::vector<uint8_t> indexes;
+    std::vector<uint8_t> data;
+    int format;
+};
+
+static std::string imageName(const char* path)
 {
-    if (argc < 2) {
-        fprintf(stderr, "bmp2img /path/to/image.bmp\n");
-        return -1;
-    }
-    char imgName[1024];
-    char* cp = strrchr(argv[1], '/');
-    if (cp) {
-        strcpy(imgName, cp + 1);
-    } else {
-        cp = strrchr(argv[1], '\\');
-        if (cp) {
-            strcpy(imgName, cp + 1);
-        } else {
-            strcpy(imgName, argv[1]);
-        }
-    }
-    cp = strchr(imgName, '.');
-    if (cp) *cp = 0;
+    const char* cp = strrchr(path, '/');
+    const char* cp2 = strrchr(path, '\\');
+    cp = cp2 && (!cp || cp < cp2) ? cp2 : cp;
+    std::string result = cp ? cp + 1 : path;
+    auto dot = result.find('.');
+    return std::string::npos == dot ? result : result.substr(0, dot);
+}
 
-    FILE* fp = fopen(argv[1], "rb");
+// BMP (4/8/24/32bit, bottom-up or top-down) -> palette + indexes
+static bool load(const char* path, Image& image)
+{
+    FILE* fp = fopen(path, "rb");
     if (!fp) {
-        fprintf(stderr, "file open error\n");
-        return -1;
+        fprintf(stderr, "%s: file open error\n", path);
+        return false;
     }
     fseek(fp, 0, SEEK_END);
-    int size = (int)ftell(fp);
-    if (size < 64) {
-        fprintf(stderr, "invalid file format\n");
-        fclose(fp);
-        return -1;
-    }
+    std::vector<uint8_t> bmp(ftell(fp));
     fseek(fp, 0, SEEK_SET);
-    unsigned char* bmp = (unsigned char*)malloc(size);
-    fread(bmp, 1, size, fp);
+    bool readResult = bmp.size() == fread(bmp.data(), 1, bmp.size(), fp);
     fclose(fp);
-
-    if (0 != memcmp(bmp, "BM", 2)) {
-        fprintf(stderr, "invalid file format (BM)\n");
-        free(bmp);
-        return -1;
+    if (!readResult || bmp.size() < 14 + sizeof(BitmapHeader) || 0 != memcmp(bmp.data(), "BM", 2)) {
+        fprintf(stderr, "%s: invalid file format (BM)\n", path);
+        return false;
     }
     BitmapHeader head;
     memcpy(&head, &bmp[14], sizeof(head));
-    if (8 != head.bits) {
-        fprintf(stderr, "invalid file format (not 8bit color mode)\n");
-        free(bmp);
-        return -1;
+    if (head.isize < (int)sizeof(head)) {
+        fprintf(stderr, "%s: invalid file format (OS/2 bitmap is not supported)\n", path);
+        return false;
     }
-    if (0 != head.ctype) {
-        fprintf(stderr, "invalid file format (not uncompressed)\n");
-        free(bmp);
-        return -1;
+    bool topDown = head.height < 0;
+    int width = head.width;
+    int height = topDown ? -head.height : head.height;
+    if (width < 1 || 0xFFFF < width || height < 1 || 0xFFFF < height) {
+        fprintf(stderr, "%s: invalid image size\n", path);
+        return false;
+    }
+    if (4 != head.bits && 8 != head.bits && 24 != head.bits && 32 != head.bits) {
+        fprintf(stderr, "%s: invalid file format (%d bit color mode is not supported)\n", path, head.bits);
+        return false;
+    }
+    if (BI_RGB != head.ctype && !(32 == head.bits && BI_BITFIELDS == head.ctype)) {
+        fprintf(stderr, "%s: invalid file format (not uncompressed)\n", path);
+        return false;
     }
-
     unsigned int offset;
     memcpy(&offset, &bmp[0xA], 4);
-    unsigned char* palPtr = &bmp[14 + 40];
-    unsigned int pal888[256];
-    for (int i = 0; i < 256; i++, palPtr += 4) {
-        pal888[i] = palPtr[2];
-        pal888[i] <<= 8;
-        pal888[i] |= palPtr[1];
-        pal888[i] <<= 8;
-        pal888[i] |= palPtr[0];
-        pal888[i] <<= 8;
-    }
-    int imgSize = head.width * head.height * 4;
-    unsigned int* img = (unsigned int*)malloc(imgSize);
-    unsigned int* imgPtr = img;
-    unsigned char* bmpPtr = &bmp[offset];
-    for (int y = 0; y < head.height; y++) {
-        for (int x = 0; x < head.width; x++) {
-            imgPtr[y * head.width + x] = pal888[bmpPtr[(head.height - y - 1) * head.width + x]];
+    size_t pitch = ((size_t)width * head.bits + 31) / 32 * 4;
+    if (bmp.size() < offset || bmp.size() - offset < pitch * height) {
+        fprintf(stderr, "%s: invalid file format (broken pixels)\n", path);
+        return false;
+    }
+
+    // indexed color: the palette follows the information header
+    std::vector<uint32_t> bmpPalette;
+    if (head.bits <= 8) {
+        size_t colors = head.cnum ? head.cnum : 1u << head.bits;
+        size_t palOffset = 14 + head.isize;
+        if (256 < colors || bmp.size() < palOffset + colors * 4) {
+            fprintf(stderr, "%s: invalid file format (broken palette)\n", path);
+            return false;
+        }
+        for (size_t i = 0; i < colors; i++) {
+            const uint8_t* p = &bmp[palOffset + i * 4];
+            bmpPalette.push_back((uint32_t)p[2] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[0] << 8 | 0xFF);
         }
     }
-    free(bmp);
 
-    imgSize /= 4;
-    printf("const unsigned int img_%s[%d] = {\n", imgName, imgSize);
-    bool firstLine = true;
-    unsigned char* cptr = (unsigned char*)img;
-    int left = imgSize;
-    for (int i = 0; i < imgSize; i += 16, left -= 16) {
-        if (firstLine) {
-            firstLine = false;
-        } else {
-            printf(",\n");
+    // convert to the palette of the used colors
+    image.name = imageName(path);
+    image.width = width;
+    image.height = height;
+    image.indexes.resize((size_t)width * height);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* line = &bmp[offset + pitch * (topDown ? y : height - y - 1)];
+        for (int x = 0; x < width; x++) {
+            uint32_t rgba;
+            if (4 == head.bits || 8 == head.bits) {
+                int index = 4 == head.bits ? (line[x / 2] >> (x & 1 ? 0 : 4)) & 0x0F : line[x];
+                if ((int)bmpPalette.size() <= index) {
+                    fprintf(stderr, "%s: invalid file format (palette index out of range)\n", path);
+                    return false;
+                }
+                rgba = bmpPalette[index];
+            } else if (24 == head.bits) {
+                const uint8_t* p = &line[x * 3];
+                rgba = (uint32_t)p[2] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[0] << 8 | 0xFF;
+            } else {
+                const uint8_t* p = &line[x * 4];
+                uint32_t alpha = BI_RGB == head.ctype ? 0xFF : p[3]; // BI_RGB: the 4th byte is not used
+                rgba = (uint32_t)p[2] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[0] << 8 | (alpha < 0x80 ? 0x00 : 0xFF);
+            }
+            if (0 == (rgba & 0xFF)) {
+                rgba = 0; // all transparent pixels share one palette entry
+            }
+            size_t index = 0;
+            while (index < image.palette.size() && image.palette[index] != rgba) {
+                index++;
+            }
+            if (index == image.palette.size()) {
+                if (256 <= index) {
+                    fprintf(stderr, "%s: too many colors (reduce to 256 colors or less)\n", path);
+                    return false;
+                }
+                image.palette.push_back(rgba);
+            }
+            image.indexes[(size_t)y * width + x] = (uint8_t)index;
         }
-        printf("    ");
-        for (int j = 0; j < (left < 16 ? left : 16); j++) {
-            if (j) {
-                printf(", 0x%X", img[i + j]);
+    }
+    return true;
+}
+
+static std::vector<uint8_t> encodeRLE(const std::vector<uint8_t>& indexes)
+{
+    std::vector<uint8_t> out;
+    size_t i = 0;
+    size_t literal = 0; // position of the literal control byte
+    bool inLiteral = false;
+    while (i < indexes.size()) {
+        size_t run = 1;
+        while (i + run < indexes.size() && run < 128 && indexes[i + run] == indexes[i]) {
+            run++;
+        }
+        if (3 <= run) {
+            out.push_back((uint8_t)(0x80 | (run - 1)));
+            out.push_back(indexes[i]);
+            i += run;
+            inLiteral = false;
+        } else {
+            if (!inLiteral || 0x7F == out[literal]) {
+                literal = out.size();
+                out.push_back(0);
+                out.push_back(indexes[i++]);
+                inLiteral = true;
             } else {
-                printf("0x%X", img[i + j]);
+                out[literal]++;
+                out.push_back(indexes[i++]);
             }
         }
     }
-    printf("\n};\n");
-    free(img);
+    return out;
+}
+
+static void put32(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.insert(out.end(), (uint8_t*)&value, (uint8_t*)&value + 4);
+}
+
+int main(int argc, char* argv[])
+{
+    int forceFormat = -1;
+    const char* atlasName = "atlas";
+    std::vector<const char*> paths;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "-i")) {
+            forceFormat = IMAGE_FORMAT_INDEXED;
+        } else if (0 == strcmp(argv[i], "-r")) {
+            forceFormat = IMAGE_FORMAT_RLE;
+        } else if (0 == strcmp(argv[i], "-n") && i + 1 < argc) {
+            atlasName = argv[++i];
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "bmp2img [-i | -r] [-n name] /path/to/image.bmp ...\n");
+        fprintf(stderr, "  -i: palette indexed (1 byte per pixel)\n");
+        fprintf(stderr, "  -r: RLE (default: the smaller one for each image)\n");
+        fprintf(stderr, "  -n: name of the atlas (default: atlas -> img_atlas)\n");
+        return -1;
+    }
+
+    std::vector<Image> images(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!load(paths[i], images[i])) {
+            return -1;
+        }
+        if (IMAGE_NAME_MAX <= images[i].name.size()) {
+            fprintf(stderr, "%s: too long name\n", paths[i]);
+            return -1;
+        }
+        auto rle = encodeRLE(images[i].indexes);
+        if (IMAGE_FORMAT_RLE == forceFormat || (forceFormat < 0 && rle.size() < images[i].indexes.size())) {
+            images[i].format = IMAGE_FORMAT_RLE;
+            images[i].data = rle;
+        } else {
+            images[i].format = IMAGE_FORMAT_INDEXED;
+            images[i].data = images[i].indexes;
+        }
+    }
+
+    // palettes of the images are stored in one table (the same palette is shared)
+    std::vector<uint32_t> palette;
+    std::vector<uint16_t> paletteOffset;
+    for (auto& image : images) {
+        size_t offset = 0;
+        while (offset < palette.size() && !(image.palette.size() <= palette.size() - offset && std::equal(image.palette.begin(), image.palette.end(), palette.begin() + offset))) {
+            offset++;
+        }
+        if (offset == palette.size()) {
+            palette.insert(palette.end(), image.palette.begin(), image.palette.end());
+        }
+        if (0xFFFF < palette.size()) {
+            fprintf(stderr, "too many palettes\n");
+            return -1;
+        }
+        paletteOffset.push_back((uint16_t)offset);
+    }
+
+    std::vector<uint8_t> atlas = {'V', 'G', 'S', '0', 'I', 'M', 'G', 0};
+    put32(atlas, (uint32_t)images.size());
+    put32(atlas, (uint32_t)palette.size());
+    for (auto color : palette) {
+        put32(atlas, color);
+    }
+    uint32_t dataOffset = (uint32_t)(atlas.size() + images.size() * sizeof(ImageAtlasEntry));
+    for (size_t i = 0; i < images.size(); i++) {
+        ImageAtlasEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        strcpy(entry.name, images[i].name.c_str());
+        entry.width = (uint16_t)images[i].width;
+        entry.height = (uint16_t)images[i].height;
+        entry.format = (uint16_t)images[i].format;
+        entry.paletteOffset = paletteOffset[i];
+        entry.dataOffset = dataOffset;
+        entry.dataSize = (uint32_t)images[i].data.size();
+        dataOffset += entry.dataSize;
+        atlas.insert(atlas.end(), (uint8_t*)&entry, (uint8_t*)&entry + sizeof(entry));
+        fprintf(stderr, "%s: %dx%d, %d colors, %s %d bytes (RGBA %d bytes)\n",
+                entry.name, entry.width, entry.height, (int)images[i].palette.size(),
+                IMAGE_FORMAT_RLE == entry.format ? "RLE" : "indexed", (int)entry.dataSize,
+                entry.width * entry.height * 4);
+    }
+    for (auto& image : images) {
+        atlas.insert(atlas.end(), image.data.begin(), image.data.end());
+    }
+
+    printf("const unsigned char img_%s[%d] = {\n", atlasName, (int)atlas.size());
+    for (size_t i = 0; i < atlas.size(); i += 16) {
+        printf("    ");
+        for (size_t j = i; j < i + 16 && j < atlas.size(); j++) {
+            printf(j == i ? "0x%02X" : ", 0x%02X", atlas[j]);
+        }
+        printf(i + 16 < atlas.size() ? ",\n" : "\n");
+    }
+    printf("};\n");
+    printf("const int img_%s_size = %d;\n", atlasName, (int)atlas.size());
+    fprintf(stderr, "img_%s: %d bytes\n", atlasName, (int)atlas.size());
     return 0;
 }
@@ -0,0 +1,85 @@
+#include "../src/flightrec.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static void printPad(char* buf, uint8_t pad)
+{
+    const char* names = "UDLRSsAB"; // UP, DOWN, LEFT, RIGHT, START, SELECT, T1, T2
+    for (int i = 0; i < 8; i++) {
+        buf[i] = (pad & (0x80 >> i)) ? names[i] : '.';
+    }
+    buf[8] = 0;
+}
+
+int main(int argc, char* argv[])
+{
+    bool inputOnly = false;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "-i")) {
+            inputOnly = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "flightrec [-i] /path/to/flightrec.dat\n");
+        fprintf(stderr, "  -i: print the joypad input of each frame only (for replay)\n");
+        return -1;
+    }
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "file open error\n");
+        return -1;
+    }
+    FlightRecorder::Header header;
+    if (1 != fread(&header, sizeof(header), 1, fp) || 0 != memcmp(header.magic, "VGS0FREC", 8)) {
+        fprintf(stderr, "invalid file format\n");
+        fclose(fp);
+        return -1;
+    }
+    if (FLIGHT_RECORDER_VERSION != header.version || sizeof(FlightRecorder::Record) != header.recordSize) {
+        fprintf(stderr, "unsupported version: %u (record size: %u)\n", header.version, header.recordSize);
+        fclose(fp);
+        return -1;
+    }
+    std::vector<FlightRecorder::Record> records(header.count);
+    size_t count = header.count ? fread(records.data(), sizeof(FlightRecorder::Record), header.count, fp) : 0;
+    fclose(fp);
+    if (count < header.count) {
+        fprintf(stderr, "warning: truncated (%d of %u records)\n", (int)count, header.count);
+    }
+
+    if (inputOnly) {
+        for (size_t i = 0; i < count; i++) {
+            printf("%u %02X\n", records[i].frame, records[i].key | records[i].pad);
+        }
+        return 0;
+    }
+
+    printf("reason: %.*s\n", (int)sizeof(header.reason), header.reason);
+    printf("frames: %d\n", (int)count);
+    printf("   frame flag key      pad      tick  conv  pres  wait audio   PC   SP   IX   IY  A  F  B  C  D  E  H  L  R  I IFF\n");
+    for (size_t i = 0; i < count; i++) {
+        auto& r = records[i];
+        char key[9];
+        char pad[9];
+        printPad(key, r.key);
+        printPad(pad, r.pad);
+        char flags[5] = {
+            (r.flags & FlightRecorder::FlagTick) ? 'T' : '-',
+            (r.flags & FlightRecorder::FlagOverlay) ? 'O' : '-',
+            (r.flags & FlightRecorder::FlagJoypadLost) ? 'J' : '-',
+            (r.flags & FlightRecorder::FlagSkip) ? 'S' : '-',
+            0,
+        };
+        printf("%8u %s %s %s %5u %5u %5u %5u %5d %04X %04X %04X %04X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X  %02X\n",
+               r.frame, flags, key, pad,
+               r.tickUs, r.convertUs, r.presentUs, r.waitUs, r.audioBytes,
+               r.pc, r.sp, r.ix, r.iy,
+               r.a, r.f, r.b, r.c, r.d, r.e, r.h, r.l, r.r, r.i, r.iff);
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Build-time comparison of gamepkg.c (hex array) and gamepkg.S (.incbin) for 1MB, 4MB and 16MB packages
+set -e
+cd "$(dirname "$0")"
+PKG2SRC="$(pwd)/pkg2src"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+now() {
+    date +%s%N
+}
+
+elapsed() {
+    echo "$1 $2" | awk '{ printf "%.2f", ($2 - $1) / 1000000000 }'
+}
+
+printf "%-6s %-10s %10s %10s %12s\n" "size" "mode" "generate" "compile" "source size"
+for MB in 1 4 16; do
+    head -c $((MB * 1024 * 1024)) /dev/urandom > "$WORK/game.pkg"
+    cd "$WORK"
+    for MODE in c S; do
+        rm -f gamepkg.c gamepkg.S gamepkg.h gamepkg.o
+        t0=$(now)
+        if [ "$MODE" = "S" ]; then
+            "$PKG2SRC" -s game.pkg
+        else
+            "$PKG2SRC" game.pkg
+        fi
+        t1=$(now)
+        ${CC:-gcc} -O2 -c gamepkg.$MODE -o gamepkg.o
+        t2=$(now)
+        printf "%-6s %-10s %9ss %9ss %12s\n" "${MB}MB" "gamepkg.$MODE" "$(elapsed $t0 $t1)" "$(elapsed $t1 $t2)" "$(wc -c < gamepkg.$MODE)"
+    done
+    cd - > /dev/null
+done
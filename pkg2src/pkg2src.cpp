@@ -1,32 +1,63 @@
+#include "../src/pkgbuild.hpp"
+#include <limits.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 
-int main(int argc, char* argv[])
+static void report(const char* name, size_t size, size_t storedSize)
+{
+    fprintf(stderr, "%s: %d -> %d bytes\n", name, (int)size, (int)storedSize);
+}
+
+// gamepkg.S: the assembler embeds game.pkg as is (fast to build even if the package is huge)
+static int writeAsm(const char* path, int size)
 {
-    if (argc < 2) {
-        fprintf(stderr, "pkg2src /path/to/game.pkg\n");
+    char absolutePath[PATH_MAX];
+    if (!realpath(path, absolutePath)) {
+        fprintf(stderr, "realpath error\n");
         return -1;
     }
-    FILE* fp = fopen(argv[1], "rb");
-    if (!fp) {
-        fprintf(stderr, "file open error\n");
+    FILE* fpS = fopen("gamepkg.S", "wt");
+    if (!fpS) {
+        fprintf(stderr, "gamepkg.S open error\n");
         return -1;
     }
-    fseek(fp, 0, SEEK_END);
-    int size = (int)ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    fprintf(fpS, "#ifdef __APPLE__\n");
+    fprintf(fpS, "#define SYMBOL(name) _##name\n");
+    fprintf(fpS, "    .section __TEXT,__const\n");
+    fprintf(fpS, "#else\n");
+    fprintf(fpS, "#define SYMBOL(name) name\n");
+    fprintf(fpS, "    .section .note.GNU-stack,\"\",@progbits\n");
+    fprintf(fpS, "    .section .rodata\n");
+    fprintf(fpS, "#endif\n");
+    fprintf(fpS, "    .globl SYMBOL(gamepkg)\n");
+    fprintf(fpS, "    .balign %d\n", PACKAGE_V2_ALIGNMENT);
+    fprintf(fpS, "SYMBOL(gamepkg):\n");
+    fprintf(fpS, "    .incbin \"%s\"\n", absolutePath);
+    fprintf(fpS, "    .globl SYMBOL(gamepkg_size)\n");
+    fprintf(fpS, "    .balign 4\n");
+    fprintf(fpS, "SYMBOL(gamepkg_size):\n");
+    fprintf(fpS, "    .long %d\n", size);
+    fclose(fpS);
+    return 0;
+}
 
+// gamepkg.c: hex array (portable, but slow to compile a multi-megabyte package)
+static int writeC(const std::vector<uint8_t>& pkg)
+{
+    int size = (int)pkg.size();
     FILE* fpC = fopen("gamepkg.c", "wt");
-    FILE* fpH = fopen("gamepkg.h", "wt");
-
-    fprintf(fpH, "#pragma once\n\n");
-    fprintf(fpH, "extern \"C\" {\n    extern const unsigned char gamepkg[%d];\n}\n", size);
-    fprintf(fpC, "const unsigned char gamepkg[%d] = {\n", size);
+    if (!fpC) {
+        fprintf(stderr, "gamepkg.c open error\n");
+        return -1;
+    }
+    fprintf(fpC, "__attribute__((aligned(%d))) const unsigned char gamepkg[%d] = {\n", PACKAGE_V2_ALIGNMENT, size);
     bool firstLine = true;
-    while (1) {
-        unsigned char buf[16];
-        int readSize = (int)fread(buf, 1, sizeof(buf), fp);
+    for (int pos = 0; true; pos += 16) {
+        const uint8_t* buf = pkg.data() + pos;
+        int readSize = size - pos < 16 ? size - pos : 16;
         if (readSize < 1) {
             fprintf(fpC, "\n");
             break;
@@ -46,6 +77,111 @@ int main(int argc, char* argv[])
         }
     }
     fprintf(fpC, "};\n");
-    fclose(fp);
+    fprintf(fpC, "const int gamepkg_size = %d;\n", size);
+    fclose(fpC);
     return 0;
 }
+
+static void putlog(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+}
+
+// gamepkg.h: the layout of the package as constexpr (an invalid package fails the build of sdlmain.cpp)
+static int writeHeader(const std::vector<uint8_t>& pkg)
+{
+    int size = (int)pkg.size();
+    Package::Layout layout;
+    Package package(putlog);
+    if (!package.parseLayout(pkg.data(), pkg.size(), &layout)) {
+        memset(&layout, 0, sizeof(layout));
+        memcpy(layout.magic, pkg.data(), pkg.size() < 8 ? pkg.size() : 8);
+    }
+    FILE* fpH = fopen("gamepkg.h", "wt");
+    if (!fpH) {
+        fprintf(stderr, "gamepkg.h open error\n");
+        return -1;
+    }
+    fprintf(fpH, "#pragma once\n");
+    fprintf(fpH, "#include \"package.hpp\"\n\n");
+    fprintf(fpH, "extern \"C\" {\n    extern const unsigned char gamepkg[%d];\n    extern const int gamepkg_size;\n}\n\n", size);
+    fprintf(fpH, "constexpr Package::Layout gamepkg_layout = {\n    {");
+    for (int i = 0; i < 8; i++) {
+        fprintf(fpH, "%s(char)0x%02X", i ? ", " : "", (uint8_t)layout.magic[i]);
+    }
+    fprintf(fpH, "},\n    {\n");
+    for (int i = 0; i < Package::SectionCount; i++) {
+        auto& e = layout.section[i];
+        fprintf(fpH, "        {%u, %u, %u, 0x%08X, 0x%08X}, // %s\n", e.offset, e.size, e.storedSize, e.flags, e.crc, Package::sectionName(i));
+    }
+    fprintf(fpH, "    },\n};\n\n");
+    fprintf(fpH, "static_assert(gamepkg_layout.isV2(), \"game.pkg is not a VGS0PKG package\");\n");
+    fprintf(fpH, "static_assert(gamepkg_layout.fits(%d), \"game.pkg is broken\");\n", size);
+    fprintf(fpH, "static_assert(PACKAGE_MIN_ROM_SIZE <= gamepkg_layout.section[Package::Rom].size, \"game.rom must be 8 + 8192 bytes or more\");\n");
+    fclose(fpH);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    bool asmMode = false;
+    bool compressMode = false;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "-s")) {
+            asmMode = true;
+        } else if (0 == strcmp(argv[i], "-z")) {
+            compressMode = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "pkg2src [-s] [-z] /path/to/game.pkg\n");
+        fprintf(stderr, "  -s: output gamepkg.S (.incbin) instead of gamepkg.c\n");
+        fprintf(stderr, "  -z: compress each section with LZ4\n");
+        fprintf(stderr, "A VGS0PKG (v1) package is converted to v2 (gamepkg.S embeds the converted gamepkg.bin),\n");
+        fprintf(stderr, "and the other packages (e.g. v2 made by pkgpack) are embedded as is.\n");
+        return -1;
+    }
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "file open error\n");
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    std::vector<uint8_t> pkg(ftell(fp));
+    fseek(fp, 0, SEEK_SET);
+    if (pkg.size() != fread(pkg.data(), 1, pkg.size(), fp)) {
+        fprintf(stderr, "file read error\n");
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    // v1 -> v2 (section directory, page aligned payloads and CRC32C)
+    PackageBuilder builder;
+    if (builder.addV1(pkg)) {
+        pkg = builder.build(compressMode, report);
+        if (asmMode) {
+            path = "gamepkg.bin";
+            FILE* fpB = fopen(path, "wb");
+            if (!fpB || pkg.size() != fwrite(pkg.data(), 1, pkg.size(), fpB)) {
+                fprintf(stderr, "gamepkg.bin write error\n");
+                return -1;
+            }
+            fclose(fpB);
+        }
+    } else if (compressMode) {
+        fprintf(stderr, "not a VGS0PKG package\n");
+        return -1;
+    }
+    int size = (int)pkg.size();
+    if (0 != writeHeader(pkg)) {
+        return -1;
+    }
+    return asmMode ? writeAsm(path, size) : writeC(pkg);
+}
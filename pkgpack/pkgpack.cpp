@@ -0,0 +1,111 @@
+#include "../src/pkgbuild.hpp"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static void putlog(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+}
+
+static void report(const char* name, size_t size, size_t storedSize)
+{
+    fprintf(stderr, "%s: %d -> %d bytes\n", name, (int)size, (int)storedSize);
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>& data)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "%s: open error\n", path);
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    data.resize(ftell(fp));
+    fseek(fp, 0, SEEK_SET);
+    bool result = data.size() == fread(data.data(), 1, data.size(), fp);
+    fclose(fp);
+    if (!result) {
+        fprintf(stderr, "%s: read error\n", path);
+    }
+    return result;
+}
+
+static int usage()
+{
+    fprintf(stderr, "pkgpack [-z] -o /path/to/game.pkg /path/to/game.rom [/path/to/bgm.dat [/path/to/se.dat]]\n");
+    fprintf(stderr, "  -z: compress each section with LZ4\n");
+    fprintf(stderr, "pkgpack -t /path/to/game.pkg\n");
+    fprintf(stderr, "  -t: verify the package (v1 or v2)\n");
+    return 1;
+}
+
+int main(int argc, char* argv[])
+{
+    bool compressMode = false;
+    const char* output = nullptr;
+    const char* test = nullptr;
+    std::vector<const char*> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "-z")) {
+            compressMode = true;
+        } else if (0 == strcmp(argv[i], "-o") && i + 1 < argc) {
+            output = argv[++i];
+        } else if (0 == strcmp(argv[i], "-t") && i + 1 < argc) {
+            test = argv[++i];
+        } else if ('-' == argv[i][0]) {
+            return usage();
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (test) {
+        std::vector<uint8_t> pkg;
+        if (!readFile(test, pkg)) {
+            return 2;
+        }
+        Package package(putlog);
+        if (!package.open(pkg.data(), pkg.size())) {
+            return 2;
+        }
+        puts("OK");
+        return 0;
+    }
+
+    if (!output || inputs.empty() || Package::SectionCount < inputs.size()) {
+        return usage();
+    }
+    PackageBuilder builder;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        std::vector<uint8_t> data;
+        if (!readFile(inputs[i], data)) {
+            return 2;
+        }
+        builder.add((Package::Section)i, data.data(), data.size());
+    }
+    for (size_t i = inputs.size(); i < Package::SectionCount; i++) {
+        builder.add((Package::Section)i, nullptr, 0);
+    }
+    auto pkg = builder.build(compressMode, report);
+
+    // verify the output with the same parser as the game
+    Package package(putlog);
+    if (!package.open(pkg.data(), pkg.size())) {
+        return 2;
+    }
+    FILE* fp = fopen(output, "wb");
+    if (!fp || pkg.size() != fwrite(pkg.data(), 1, pkg.size(), fp)) {
+        fprintf(stderr, "%s: write error\n", output);
+        return 2;
+    }
+    fclose(fp);
+    printf("%s: %d bytes\n", output, (int)pkg.size());
+    return 0;
+}
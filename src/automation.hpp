@@ -0,0 +1,339 @@
+/**
+ * VGS-Zero SDK for Steam - Automation control socket and shared memory frame access for Linux and macOS
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * control socket (enable "automation.control" in config.json): one command per line
+ *   pause          ... stop ticking the emulator and the sound (the window is still rendered)
+ *   resume         ... restart ticking
+ *   step N         ... tick N frames while paused (the reply is sent after the last frame)
+ *   pad XX | off   ... inject the joypad input (hex: VGS0_JOYPAD_*) in place of the keyboard and SteamInput
+ *   reset          ... reset the emulator
+ *   status         ... current frame number, pause state and injected input
+ *   -> "OK ..." or "ERR ..."
+ *
+ * shared memory (set "automation.sharedMemory" in config.json, e.g. "/vgs0"): AutomationShm
+ *   frames: ring of AUTOMATION_SHM_FRAMES RGB555 240x192 screens, frames[(frameSeq - 1) % AUTOMATION_SHM_FRAMES] is the latest
+ *   audio: ring of AUTOMATION_SHM_AUDIO bytes (44100Hz/16bit/mono), audioSeq is the total bytes written (not advanced while paused)
+ *   magic: "VGS0SHM" is published last with a release store, so a reader that loads it with acquire sees the other fields
+ *   Readers copy a slot and then re-check the sequence: a slot is overwritten AUTOMATION_SHM_FRAMES frames later.
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#define AUTOMATION_POLL_MS 200
+#define AUTOMATION_STEP_TIMEOUT_MS 10000
+#define AUTOMATION_SHM_FRAMES 4
+#define AUTOMATION_SHM_AUDIO 0x10000 // must be power of 2
+#define AUTOMATION_SHM_VERSION 1
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS: SO_NOSIGPIPE is set to the client socket instead
+#endif
+
+struct AutomationShm {
+    std::atomic<uint64_t> magic; // "VGS0SHM\0" in the memory order (0: not ready)
+    uint32_t version;
+    uint16_t width;
+    uint16_t height;
+    uint32_t frameSlots;
+    uint32_t audioSize;
+    std::atomic<uint64_t> frameSeq; // number of the published frames
+    std::atomic<uint64_t> audioSeq; // total bytes of the published audio
+    uint16_t frames[AUTOMATION_SHM_FRAMES][240 * 192];
+    uint8_t audio[AUTOMATION_SHM_AUDIO];
+};
+
+class Automation
+{
+  private:
+    void (*putlog)(const char*, ...);
+    std::string socketPath;
+    std::string shmName;
+    int fd;
+    AutomationShm* shm;
+    std::thread thread;
+    std::atomic<bool> end;
+    std::atomic<bool> paused;
+    std::atomic<int> steps;
+    std::atomic<int> pad; // -1: not injected
+    std::atomic<bool> resetRequest;
+    std::atomic<uint64_t> frames;
+    std::mutex mutex;
+    std::condition_variable cond;
+
+  public:
+    Automation(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+        this->fd = -1;
+        this->shm = nullptr;
+        this->end.store(false);
+        this->paused.store(false);
+        this->steps.store(0);
+        this->pad.store(-1);
+        this->resetRequest.store(false);
+        this->frames.store(0);
+    }
+
+    ~Automation()
+    {
+        if (0 <= this->fd) {
+            this->end.store(true);
+            this->cond.notify_all();
+            this->thread.join();
+            close(this->fd);
+            unlink(this->socketPath.c_str());
+        }
+        if (this->shm) {
+            munmap(this->shm, sizeof(AutomationShm));
+            shm_unlink(this->shmName.c_str());
+        }
+    }
+
+    bool startControl(const char* path)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (sizeof(addr.sun_path) <= strlen(path)) {
+            putlog("Control socket path is too long: %s", path);
+            return false;
+        }
+        strcpy(addr.sun_path, path);
+        this->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (this->fd < 0) {
+            putlog("Control socket create failed");
+            return false;
+        }
+        unlink(path); // remove the stale socket of the previous process
+        if (0 != bind(this->fd, (struct sockaddr*)&addr, sizeof(addr)) || 0 != listen(this->fd, 1)) {
+            putlog("Control socket bind failed: %s", path);
+            close(this->fd);
+            this->fd = -1;
+            return false;
+        }
+        this->socketPath = path;
+        this->thread = std::thread([this]() { this->main(); });
+        putlog("Control socket: %s", path);
+        return true;
+    }
+
+    bool startSharedMemory(const char* name)
+    {
+        int shmFd = shm_open(name, O_RDWR | O_CREAT, 0600);
+        if (shmFd < 0) {
+            putlog("shm_open failed: %s", name);
+            return false;
+        }
+        if (0 != ftruncate(shmFd, sizeof(AutomationShm))) {
+            putlog("ftruncate failed: %s", name);
+            close(shmFd);
+            shm_unlink(name);
+            return false;
+        }
+        void* ptr = mmap(nullptr, sizeof(AutomationShm), PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+        close(shmFd);
+        if (MAP_FAILED == ptr) {
+            putlog("mmap failed: %s", name);
+            shm_unlink(name);
+            return false;
+        }
+        this->shm = (AutomationShm*)ptr;
+        this->shm->magic.store(0, std::memory_order_relaxed); // hide the fields of the previous process until the release below
+        this->shm->version = AUTOMATION_SHM_VERSION;
+        this->shm->width = 240;
+        this->shm->height = 192;
+        this->shm->frameSlots = AUTOMATION_SHM_FRAMES;
+        this->shm->audioSize = AUTOMATION_SHM_AUDIO;
+        this->shm->frameSeq.store(0);
+        this->shm->audioSeq.store(0);
+        uint64_t magic;
+        memcpy(&magic, "VGS0SHM", 8);
+        this->shm->magic.store(magic, std::memory_order_release); // the readers wait for the magic
+        this->shmName = name;
+        putlog("Shared memory: %s (%d bytes)", name, (int)sizeof(AutomationShm));
+        return true;
+    }
+
+    /**
+     * Called before the tick (false: paused)
+     */
+    inline bool tickable()
+    {
+        return !this->paused.load(std::memory_order_relaxed) || 0 < this->steps.load(std::memory_order_acquire);
+    }
+
+    inline bool resetRequested()
+    {
+        return this->resetRequest.exchange(false, std::memory_order_relaxed);
+    }
+
+    inline unsigned char input(unsigned char pad)
+    {
+        int injected = this->pad.load(std::memory_order_relaxed);
+        return injected < 0 ? pad : (unsigned char)injected;
+    }
+
+    /**
+     * Called after the tick with the emulator screen (publish the frame and count the step)
+     */
+    void ticked(const unsigned short* display)
+    {
+        if (this->shm) {
+            uint64_t seq = this->shm->frameSeq.load(std::memory_order_relaxed);
+            memcpy(this->shm->frames[seq % AUTOMATION_SHM_FRAMES], display, sizeof(this->shm->frames[0]));
+            this->shm->frameSeq.store(seq + 1, std::memory_order_release);
+        }
+        this->frames.fetch_add(1, std::memory_order_relaxed);
+        if (0 < this->steps.load(std::memory_order_relaxed) && 1 == this->steps.fetch_sub(1, std::memory_order_acq_rel)) {
+            { std::unique_lock<std::mutex> lock(this->mutex); } // the control thread is waiting or checking the steps
+            this->cond.notify_all();
+        }
+    }
+
+    /**
+     * Called from the audio callback
+     */
+    void audio(const void* data, int size)
+    {
+        if (!this->shm) {
+            return;
+        }
+        uint64_t seq = this->shm->audioSeq.load(std::memory_order_relaxed);
+        auto ptr = (const uint8_t*)data;
+        while (0 < size) {
+            int offset = (int)(seq & (AUTOMATION_SHM_AUDIO - 1));
+            int len = AUTOMATION_SHM_AUDIO - offset < size ? AUTOMATION_SHM_AUDIO - offset : size;
+            memcpy(&this->shm->audio[offset], ptr, len);
+            ptr += len;
+            size -= len;
+            seq += len;
+        }
+        this->shm->audioSeq.store(seq, std::memory_order_release);
+    }
+
+  private:
+    void main()
+    {
+        while (!this->end.load()) {
+            struct pollfd pfd = {this->fd, POLLIN, 0};
+            if (poll(&pfd, 1, AUTOMATION_POLL_MS) <= 0) {
+                continue;
+            }
+            int client = accept(this->fd, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+#ifdef SO_NOSIGPIPE
+            int on = 1;
+            setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+            putlog("Control client connected");
+            this->serve(client);
+            close(client);
+            putlog("Control client disconnected");
+        }
+    }
+
+    void serve(int client)
+    {
+        std::string line;
+        char buf[256];
+        while (!this->end.load()) {
+            struct pollfd pfd = {client, POLLIN, 0};
+            int ready = poll(&pfd, 1, AUTOMATION_POLL_MS);
+            if (ready < 0) {
+                return;
+            } else if (0 == ready) {
+                continue;
+            }
+            auto len = recv(client, buf, sizeof(buf), 0);
+            if (len <= 0) {
+                return;
+            }
+            for (int i = 0; i < len; i++) {
+                if ('\n' == buf[i]) {
+                    std::string response = this->execute(line) + "\n";
+                    if (send(client, response.c_str(), response.size(), MSG_NOSIGNAL) < 0) {
+                        return;
+                    }
+                    line.clear();
+                } else if ('\r' != buf[i]) {
+                    line += buf[i];
+                }
+            }
+        }
+    }
+
+    std::string execute(const std::string& line)
+    {
+        char command[16];
+        char arg[32];
+        char response[128];
+        arg[0] = 0;
+        if (sscanf(line.c_str(), "%15s %31s", command, arg) < 1) {
+            return "ERR empty command";
+        }
+        if (0 == strcmp(command, "pause")) {
+            this->paused.store(true);
+        } else if (0 == strcmp(command, "resume")) {
+            this->paused.store(false);
+        } else if (0 == strcmp(command, "step")) {
+            int n = atoi(arg);
+            if (n < 1) {
+                return "ERR invalid step count";
+            }
+            this->paused.store(true);
+            this->steps.fetch_add(n);
+            std::unique_lock<std::mutex> lock(this->mutex);
+            bool done = this->cond.wait_for(lock, std::chrono::milliseconds(AUTOMATION_STEP_TIMEOUT_MS), [this]() {
+                return this->steps.load() <= 0 || this->end.load();
+            });
+            if (!done) {
+                return "ERR step timeout";
+            }
+        } else if (0 == strcmp(command, "pad")) {
+            if (0 == strcmp(arg, "off")) {
+                this->pad.store(-1);
+            } else {
+                char* endptr;
+                long value = strtol(arg, &endptr, 16);
+                if (!arg[0] || *endptr || value < 0 || 0xFF < value) {
+                    return "ERR invalid pad value";
+                }
+                this->pad.store((int)value);
+            }
+        } else if (0 == strcmp(command, "reset")) {
+            this->resetRequest.store(true);
+        } else if (0 != strcmp(command, "status")) {
+            return "ERR unknown command";
+        }
+        int pad = this->pad.load();
+        char padText[12];
+        if (0 <= pad) {
+            snprintf(padText, sizeof(padText), "%02X", pad);
+        } else {
+            strcpy(padText, "off");
+        }
+        snprintf(response, sizeof(response), "OK frame=%llu paused=%d pad=%s",
+                 (unsigned long long)this->frames.load(),
+                 this->paused.load() ? 1 : 0,
+                 padText);
+        return response;
+    }
+};
@@ -0,0 +1,173 @@
+/**
+ * VGS-Zero SDK for Steam - CRC32C (Castagnoli) for the package integrity check
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * The CRC32C instructions (x86: SSE4.2, ARM: ARMv8 CRC) are used if the CPU supports them (checked at runtime),
+ * and the table is used on the other CPUs.
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CRC32C_X86
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32C_TARGET
+#else
+#include <cpuid.h>
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CRC32C_ARM
+#include <arm_acle.h>
+#if defined(__APPLE__) || defined(_MSC_VER)
+#define CRC32C_TARGET
+#elif defined(__clang__)
+#define CRC32C_TARGET __attribute__((target("crc")))
+#else
+#define CRC32C_TARGET __attribute__((target("+crc")))
+#endif
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+#endif
+
+class CRC32C
+{
+  private:
+    struct Table {
+        uint32_t value[256];
+        Table()
+        {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t crc = i;
+                for (int j = 0; j < 8; j++) {
+                    crc = (crc >> 1) ^ (crc & 1 ? 0x82F63B78 : 0);
+                }
+                this->value[i] = crc;
+            }
+        }
+    };
+
+    static const uint32_t* table()
+    {
+        static const Table result; // thread safe initialization
+        return result.value;
+    }
+
+    static uint32_t calcTable(const uint8_t* ptr, size_t size, uint32_t crc)
+    {
+        const uint32_t* t = table();
+        while (size--) {
+            crc = t[(crc ^ *ptr++) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+#if defined(CRC32C_X86)
+    CRC32C_TARGET static uint32_t calcHardware(const uint8_t* ptr, size_t size, uint32_t crc)
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        uint64_t crc64 = crc;
+        for (; 8 <= size; ptr += 8, size -= 8) {
+            uint64_t value;
+            memcpy(&value, ptr, 8);
+            crc64 = _mm_crc32_u64(crc64, value);
+        }
+        crc = (uint32_t)crc64;
+#else
+        for (; 4 <= size; ptr += 4, size -= 4) {
+            uint32_t value;
+            memcpy(&value, ptr, 4);
+            crc = _mm_crc32_u32(crc, value);
+        }
+#endif
+        while (size--) {
+            crc = _mm_crc32_u8(crc, *ptr++);
+        }
+        return crc;
+    }
+
+    static bool hasHardware()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        return 0 != (info[2] & (1 << 20));
+#else
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && 0 != (ecx & bit_SSE4_2);
+#endif
+    }
+#elif defined(CRC32C_ARM)
+    CRC32C_TARGET static uint32_t calcHardware(const uint8_t* ptr, size_t size, uint32_t crc)
+    {
+        for (; 8 <= size; ptr += 8, size -= 8) {
+            uint64_t value;
+            memcpy(&value, ptr, 8);
+            crc = __crc32cd(crc, value);
+        }
+        while (size--) {
+            crc = __crc32cb(crc, *ptr++);
+        }
+        return crc;
+    }
+
+    static bool hasHardware()
+    {
+#if defined(__linux__)
+        return 0 != (getauxval(AT_HWCAP) & HWCAP_CRC32);
+#else
+        return true; // all Apple Silicon and Windows on ARM CPUs have the CRC instructions
+#endif
+    }
+#else
+    static uint32_t calcHardware(const uint8_t* ptr, size_t size, uint32_t crc) { return calcTable(ptr, size, crc); }
+    static bool hasHardware() { return false; }
+#endif
+
+    static bool useHardware()
+    {
+        static const bool result = hasHardware();
+        return result;
+    }
+
+  public:
+    /**
+     * CRC32C of the data (pass the previous result as crc to continue)
+     */
+    static uint32_t calc(const void* data, size_t size, uint32_t crc = 0)
+    {
+        auto ptr = (const uint8_t*)data;
+        return ~(useHardware() ? calcHardware(ptr, size, ~crc) : calcTable(ptr, size, ~crc));
+    }
+
+    /**
+     * Name of the implementation used by calc (for the log)
+     */
+    static const char* implementation()
+    {
+#if defined(CRC32C_X86)
+        return useHardware() ? "SSE4.2" : "table";
+#elif defined(CRC32C_ARM)
+        return useHardware() ? "ARMv8 CRC" : "table";
+#else
+        return "table";
+#endif
+    }
+
+    /**
+     * Table implementation regardless of the CPU (for the self check and the benchmark)
+     */
+    static uint32_t calcPortable(const void* data, size_t size, uint32_t crc = 0)
+    {
+        return ~calcTable((const uint8_t*)data, size, ~crc);
+    }
+};
@@ -0,0 +1,188 @@
+/**
+ * VGS-Zero SDK for Steam - Crash flight recorder for Linux and macOS
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * Keeps the last FLIGHT_RECORDER_FRAMES frames (input, stage timings, audio and Z80 registers)
+ * in a fixed ring and dumps them to flightrec.dat on crash or HALT (decode with ./flightrec).
+ *
+ * file format (little endian):
+ *   FlightRecorder::Header
+ *   FlightRecorder::Record x Header.count (oldest first)
+ */
+#pragma once
+#include <atomic>
+#include <csignal>
+#include <fcntl.h>
+#include <initializer_list>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FLIGHT_RECORDER_FILE "flightrec.dat"
+#define FLIGHT_RECORDER_FRAMES 600 // 10 seconds
+#define FLIGHT_RECORDER_VERSION 1
+
+class FlightRecorder
+{
+  public:
+    enum Flag : uint8_t {
+        FlagTick = 0x01,        // emulator ticked in this frame
+        FlagOverlay = 0x02,     // Steam overlay was active
+        FlagJoypadLost = 0x04,  // waiting for the joypad reconnection
+        FlagSkip = 0x08,        // conversion, upload and present were skipped (frame skip)
+    };
+
+    struct Header {
+        char magic[8]; // "VGS0FREC"
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t count;
+        char reason[28];
+    };
+
+    struct Record {
+        uint32_t frame;
+        uint8_t key;        // keyboard
+        uint8_t pad;        // SteamInput
+        uint8_t flags;      // Flag
+        uint8_t reserved;
+        uint32_t tickUs;    // elapsed since the frame begin at the end of each stage
+        uint32_t convertUs;
+        uint32_t presentUs;
+        uint32_t waitUs;    // sleep for 60fps
+        int32_t audioBytes; // bytes requested by the audio callback since the previous frame
+        uint16_t pc, sp, ix, iy;
+        uint8_t a, f, b, c, d, e, h, l;
+        uint8_t r, i, iff, reserved2;
+    };
+    static_assert(sizeof(Header) == 48, "unexpected Header size");
+    static_assert(sizeof(Record) == 48, "unexpected Record size");
+
+  private:
+    static FlightRecorder* instance; // for the signal handler
+    static void (*previousHandler[32])(int);
+    void (*putlog)(const char*, ...);
+    Record records[FLIGHT_RECORDER_FRAMES];
+    std::atomic<uint32_t> head;
+    std::atomic<int32_t> audioBytes;
+    std::atomic<bool> dumped;
+
+  public:
+    FlightRecorder(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+        memset(this->records, 0, sizeof(this->records));
+        this->head.store(0, std::memory_order_relaxed);
+        this->audioBytes.store(0, std::memory_order_relaxed);
+        this->dumped.store(false, std::memory_order_relaxed);
+        instance = this;
+        this->installCrashHandler();
+        putlog("Flight recorder: the last %d frames are dumped to %s on crash", FLIGHT_RECORDER_FRAMES, FLIGHT_RECORDER_FILE);
+    }
+
+    ~FlightRecorder()
+    {
+        instance = nullptr;
+    }
+
+    /**
+     * Start recording a new frame (the returned record is filled during the frame)
+     */
+    Record* next(uint32_t frame, uint8_t key, uint8_t pad)
+    {
+        uint32_t index = this->head.load(std::memory_order_relaxed);
+        Record* record = &this->records[index % FLIGHT_RECORDER_FRAMES];
+        memset(record, 0, sizeof(Record));
+        record->frame = frame;
+        record->key = key;
+        record->pad = pad;
+        record->audioBytes = this->audioBytes.exchange(0, std::memory_order_relaxed);
+        this->head.store(index + 1, std::memory_order_release);
+        return record;
+    }
+
+    /**
+     * Called from the audio callback
+     */
+    inline void audio(int bytes)
+    {
+        this->audioBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    template <class Register>
+    static void snapshot(Record* record, const Register& reg)
+    {
+        record->pc = reg.PC;
+        record->sp = reg.SP;
+        record->ix = reg.IX;
+        record->iy = reg.IY;
+        record->a = reg.pair.A;
+        record->f = reg.pair.F;
+        record->b = reg.pair.B;
+        record->c = reg.pair.C;
+        record->d = reg.pair.D;
+        record->e = reg.pair.E;
+        record->h = reg.pair.H;
+        record->l = reg.pair.L;
+        record->r = reg.R;
+        record->i = reg.I;
+        record->iff = reg.IFF;
+    }
+
+    /**
+     * Write the ring to flightrec.dat (async-signal-safe)
+     */
+    bool dump(const char* reason)
+    {
+        if (this->dumped.exchange(true, std::memory_order_acq_rel)) {
+            return false;
+        }
+        int fd = open(FLIGHT_RECORDER_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        uint32_t head = this->head.load(std::memory_order_acquire);
+        uint32_t count = head < FLIGHT_RECORDER_FRAMES ? head : FLIGHT_RECORDER_FRAMES;
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "VGS0FREC", 8);
+        header.version = FLIGHT_RECORDER_VERSION;
+        header.recordSize = sizeof(Record);
+        header.count = count;
+        strncpy(header.reason, reason, sizeof(header.reason) - 1);
+        bool result = sizeof(header) == ::write(fd, &header, sizeof(header));
+        uint32_t oldest = (head - count) % FLIGHT_RECORDER_FRAMES;
+        uint32_t first = FLIGHT_RECORDER_FRAMES - oldest < count ? FLIGHT_RECORDER_FRAMES - oldest : count;
+        result = result && (ssize_t)(sizeof(Record) * first) == ::write(fd, &this->records[oldest], sizeof(Record) * first);
+        if (first < count) {
+            result = result && (ssize_t)(sizeof(Record) * (count - first)) == ::write(fd, this->records, sizeof(Record) * (count - first));
+        }
+        fsync(fd);
+        close(fd);
+        return result;
+    }
+
+  private:
+    void installCrashHandler()
+    {
+        for (int sig : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) {
+            // chain to the previous handler (e.g., Logger) after the dump
+            previousHandler[sig] = std::signal(sig, [](int sig) {
+                if (instance) {
+                    instance->dump(SIGSEGV == sig ? "SIGSEGV" : SIGBUS == sig ? "SIGBUS" : SIGFPE == sig ? "SIGFPE" : SIGILL == sig ? "SIGILL" : "SIGABRT");
+                }
+                auto previous = previousHandler[sig];
+                if (previous && SIG_DFL != previous && SIG_IGN != previous && SIG_ERR != previous) {
+                    previous(sig);
+                } else {
+                    std::signal(sig, SIG_DFL);
+                    raise(sig);
+                }
+            });
+        }
+    }
+};
+
+FlightRecorder* FlightRecorder::instance = nullptr;
+void (*FlightRecorder::previousHandler[32])(int);
@@ -0,0 +1,120 @@
+/**
+ * VGS-Zero SDK for Steam - Adaptive frame skip for the hosts that cannot hold 60fps
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * The emulator ticks every frame, and the conversion, upload and present are skipped at the skip level:
+ * level N draws 1 frame per N + 1 frames.
+ * The level is raised when the moving average cost at the current level exceeds the frame budget,
+ * and lowered when the cost at the lower level stays under 85% of the budget for FRAME_SKIP_HOLD_FRAMES.
+ * The overrun of a frame is paid back by the sleep of the following frames to keep the real time.
+ */
+#pragma once
+#include <string.h>
+
+#define FRAME_SKIP_BUDGET_US 16667
+#define FRAME_SKIP_HOLD_FRAMES 60
+#define FRAME_SKIP_REPORT_FRAMES 600
+
+class FrameSkip
+{
+  private:
+    void (*putlog)(const char*, ...);
+    int maxSkip;
+    int level;
+    int skipped;     // continuous skipped frames
+    double tickUs;   // moving average of the frame cost without the render
+    double renderUs; // moving average of the conversion, upload and present
+    int hold;
+    int debtUs;
+    struct Report {
+        int frames;
+        int skipped;
+        int maxLevel;
+    } report;
+
+    inline double cost(int level) { return this->tickUs + this->renderUs / (level + 1); }
+
+    static inline void average(double* value, double sample)
+    {
+        *value = *value < 0 ? sample : *value + (sample - *value) / 16;
+    }
+
+  public:
+    FrameSkip(void (*putlog)(const char*, ...), int maxSkip)
+    {
+        this->putlog = putlog;
+        this->maxSkip = maxSkip < 0 ? 0 : maxSkip;
+        this->level = 0;
+        this->skipped = 0;
+        this->tickUs = -1;
+        this->renderUs = -1;
+        this->hold = 0;
+        this->debtUs = 0;
+        memset(&this->report, 0, sizeof(this->report));
+        if (this->maxSkip) {
+            putlog("Adaptive frame skip: up to %d frames", this->maxSkip);
+        }
+    }
+
+    /**
+     * Returns true if this frame is converted, uploaded and presented
+     */
+    bool draw()
+    {
+        if (this->skipped < this->level) {
+            this->skipped++;
+            return false;
+        }
+        this->skipped = 0;
+        return true;
+    }
+
+    /**
+     * Update the level with the cost of the frame (frameUs: without the sleep, renderUs: -1 if skipped)
+     * and returns the sleep to keep 60fps (wait: nominal frame time)
+     */
+    int update(int frameUs, int renderUs, int wait)
+    {
+        if (!this->maxSkip) {
+            return frameUs < wait ? wait - frameUs : 0;
+        }
+        bool drawn = 0 <= renderUs;
+        average(&this->tickUs, drawn ? frameUs - renderUs : frameUs);
+        if (drawn) {
+            average(&this->renderUs, renderUs);
+        }
+        if (this->level < this->maxSkip && FRAME_SKIP_BUDGET_US < this->cost(this->level)) {
+            this->level++;
+            this->hold = 0;
+        } else if (0 < this->level && this->cost(this->level - 1) < FRAME_SKIP_BUDGET_US * 0.85) {
+            if (FRAME_SKIP_HOLD_FRAMES <= ++this->hold) {
+                this->level--;
+                this->hold = 0;
+            }
+        } else {
+            this->hold = 0;
+        }
+
+        this->report.frames++;
+        this->report.skipped += drawn ? 0 : 1;
+        this->report.maxLevel = this->report.maxLevel < this->level ? this->level : this->report.maxLevel;
+        if (FRAME_SKIP_REPORT_FRAMES <= this->report.frames) {
+            if (this->report.skipped) {
+                putlog("Frame skip: %d/%d frames skipped (level %d, max %d, tick %.1fms + render %.1fms)",
+                       this->report.skipped, this->report.frames, this->level, this->report.maxLevel,
+                       this->tickUs / 1000, this->renderUs / 1000);
+            }
+            memset(&this->report, 0, sizeof(this->report));
+        }
+
+        // pay back the overrun (a long stall such as a hitch is not paid back beyond 2 frames)
+        int sleep = wait - frameUs - this->debtUs;
+        if (sleep < 0) {
+            this->debtUs = -sleep < FRAME_SKIP_BUDGET_US * 2 ? -sleep : FRAME_SKIP_BUDGET_US * 2;
+            return 0;
+        }
+        this->debtUs = 0;
+        return sleep;
+    }
+};
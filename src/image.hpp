@@ -0,0 +1,156 @@
+/**
+ * VGS-Zero SDK for Steam - Image atlas decoder (the atlas is made by bmp2img)
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * atlas (little endian):
+ *   "VGS0IMG\0", uint32 imageCount, uint32 paletteCount
+ *   uint32 palette[paletteCount] ... RGBA8888 (the same as the frame buffer), alpha 0: transparent
+ *   ImageAtlasEntry[imageCount]
+ *   pixel data of each image (width x height palette indexes from the top left):
+ *   - IMAGE_FORMAT_INDEXED: 1 byte per pixel
+ *   - IMAGE_FORMAT_RLE: control byte c, then
+ *     - c < 0x80: c + 1 literal indexes
+ *     - c >= 0x80: (c & 0x7F) + 1 pixels of the next index
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define IMAGE_FORMAT_INDEXED 0
+#define IMAGE_FORMAT_RLE 1
+#define IMAGE_NAME_MAX 24
+
+struct ImageAtlasEntry {
+    char name[IMAGE_NAME_MAX]; // file name without the extension
+    uint16_t width;
+    uint16_t height;
+    uint16_t format;        // IMAGE_FORMAT_*
+    uint16_t paletteOffset; // the first palette entry of the image
+    uint32_t dataOffset;    // from the top of the atlas
+    uint32_t dataSize;
+};
+
+class ImageAtlas
+{
+  private:
+    void (*putlog)(const char*, ...);
+    const uint8_t* atlas;
+    const uint8_t* palette;
+    const uint8_t* entries;
+    uint32_t imageCount;
+    uint32_t paletteCount;
+
+    ImageAtlasEntry entry(int index)
+    {
+        ImageAtlasEntry result;
+        memcpy(&result, this->entries + index * sizeof(ImageAtlasEntry), sizeof(result));
+        return result;
+    }
+
+    inline uint32_t color(uint32_t index)
+    {
+        uint32_t result;
+        memcpy(&result, this->palette + index * 4, 4);
+        return result;
+    }
+
+  public:
+    ImageAtlas(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+        this->atlas = nullptr;
+        this->imageCount = 0;
+        this->paletteCount = 0;
+    }
+
+    bool open(const void* atlas, size_t size)
+    {
+        auto ptr = (const uint8_t*)atlas;
+        if (size < 16 || 0 != memcmp(ptr, "VGS0IMG", 8)) {
+            putlog("Invalid image atlas!");
+            return false;
+        }
+        memcpy(&this->imageCount, ptr + 8, 4);
+        memcpy(&this->paletteCount, ptr + 12, 4);
+        size_t headerSize = 16 + (size_t)this->paletteCount * 4 + (size_t)this->imageCount * sizeof(ImageAtlasEntry);
+        if (0xFFFF < this->paletteCount || 0xFFFF < this->imageCount || size < headerSize) {
+            putlog("Invalid image atlas! (broken header)");
+            return false;
+        }
+        this->palette = ptr + 16;
+        this->entries = this->palette + this->paletteCount * 4;
+        for (uint32_t i = 0; i < this->imageCount; i++) {
+            auto e = this->entry(i);
+            if (size < e.dataOffset || size - e.dataOffset < e.dataSize || this->paletteCount < e.paletteOffset) {
+                putlog("Invalid image atlas! (broken image: %d)", (int)i);
+                return false;
+            }
+        }
+        this->atlas = ptr;
+        return true;
+    }
+
+    /**
+     * Index of the image (-1: not found)
+     */
+    int find(const char* name)
+    {
+        for (uint32_t i = 0; i < this->imageCount; i++) {
+            auto e = this->entry(i);
+            if (0 == strncmp(e.name, name, IMAGE_NAME_MAX)) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    int getWidth(int index) { return this->entry(index).width; }
+    int getHeight(int index) { return this->entry(index).height; }
+
+    /**
+     * Expand the image into the RGBA8888 buffer (pitch: pixels per line, clipped by width x height)
+     */
+    void draw(int index, uint32_t* buffer, int pitch, int width, int height, int dx, int dy)
+    {
+        auto e = this->entry(index);
+        const uint8_t* src = this->atlas + e.dataOffset;
+        const uint8_t* end = src + e.dataSize;
+        int paletteLimit = (int)(this->paletteCount - e.paletteOffset);
+        int x = 0;
+        int y = 0;
+        auto put = [&](uint8_t index, int count) {
+            uint32_t c = index < paletteLimit ? this->color(e.paletteOffset + index) : 0;
+            for (; 0 < count && y < e.height; count--) {
+                int px = dx + x;
+                int py = dy + y;
+                if ((c & 0xFF) && 0 <= px && px < width && 0 <= py && py < height) {
+                    buffer[py * pitch + px] = c;
+                }
+                if (e.width <= ++x) {
+                    x = 0;
+                    y++;
+                }
+            }
+        };
+        if (IMAGE_FORMAT_RLE == e.format) {
+            while (src < end && y < e.height) {
+                uint8_t c = *src++;
+                if (c & 0x80) {
+                    if (src < end) {
+                        put(*src++, (c & 0x7F) + 1);
+                    }
+                } else {
+                    for (int n = c + 1; 0 < n && src < end; n--) {
+                        put(*src++, 1);
+                    }
+                }
+            }
+        } else {
+            while (src < end && y < e.height) {
+                put(*src++, 1);
+            }
+        }
+    }
+};
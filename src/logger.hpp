@@ -0,0 +1,396 @@
+/**
+ * VGS-Zero SDK for Steam - Asynchronous logger
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <mutex>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#define LOGGER_WRITE(fd, buf, len) _write(fd, buf, (unsigned int)(len))
+#define LOGGER_FILENO(fp) _fileno(fp)
+#else
+#include <unistd.h>
+#define LOGGER_WRITE(fd, buf, len) write(fd, buf, len)
+#define LOGGER_FILENO(fp) fileno(fp)
+#endif
+
+#define LOGGER_FILE "log.txt"
+#define LOGGER_ROTATED_FILE "log.1.txt"
+#define LOGGER_MAX_FILE_SIZE (1024 * 1024)
+#define LOGGER_QUEUE_SIZE 1024 // must be power of 2
+#define LOGGER_MESSAGE_SIZE 256
+#define LOGGER_FLUSH_INTERVAL_MS 50
+#define LOGGER_RATE_LIMIT 20 // messages per second per format
+#define LOGGER_RATE_TABLE_SIZE 256 // formats (open addressing by the pointer, must be power of 2)
+#define LOGGER_CRASH_SPIN 1000000   // wait for the flush thread in the crash handler
+
+class Logger
+{
+  public:
+    enum class Level : uint8_t {
+        Debug,
+        Info,
+        Warn,
+        Error,
+    };
+
+  private:
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        Level level;
+        int64_t time;
+        char text[LOGGER_MESSAGE_SIZE];
+    };
+
+    struct Rate {
+        std::atomic<const char*> format;
+        std::atomic<int64_t> second;
+        std::atomic<int> count;
+        std::atomic<int> suppressed;
+    };
+
+    static Logger* instance; // for the crash handler
+    Slot slots[LOGGER_QUEUE_SIZE];
+    Rate rates[LOGGER_RATE_TABLE_SIZE];
+    std::atomic<uint32_t> head; // producers
+    uint32_t tail;              // consumer (flush thread or crash handler)
+    std::atomic<int64_t> clock; // cached time(nullptr) updated by the flush thread
+    std::atomic<uint32_t> dropped;
+    std::atomic<bool> crashed;
+    std::atomic<bool> consuming; // the flush thread or the crash handler owns the tail
+    Level minLevel;
+    FILE* fp;
+    long fileSize;
+    int64_t prefixTime;
+    char prefix[64];
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread thread;
+    bool end;
+
+  public:
+    Logger(Level minLevel = Level::Debug)
+    {
+        this->minLevel = minLevel;
+        for (int i = 0; i < LOGGER_QUEUE_SIZE; i++) {
+            this->slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < LOGGER_RATE_TABLE_SIZE; i++) {
+            this->rates[i].format.store(nullptr, std::memory_order_relaxed);
+            this->rates[i].second.store(0, std::memory_order_relaxed);
+            this->rates[i].count.store(0, std::memory_order_relaxed);
+            this->rates[i].suppressed.store(0, std::memory_order_relaxed);
+        }
+        this->head.store(0, std::memory_order_relaxed);
+        this->tail = 0;
+        this->clock.store((int64_t)time(nullptr), std::memory_order_relaxed);
+        this->dropped.store(0, std::memory_order_relaxed);
+        this->crashed.store(false, std::memory_order_relaxed);
+        this->consuming.store(false, std::memory_order_relaxed);
+        this->prefixTime = -1;
+        this->prefix[0] = 0;
+        this->end = false;
+        this->fp = fopen(LOGGER_FILE, "a");
+        this->fileSize = this->fp ? ftell(this->fp) : 0;
+        instance = this;
+        this->installCrashHandler();
+        this->thread = std::thread([this]() { this->main(); });
+    }
+
+    ~Logger()
+    {
+        this->shutdown();
+        if (this->fp) {
+            fclose(this->fp);
+        }
+        instance = nullptr;
+    }
+
+    /**
+     * Write the queued messages and stop the flush thread.
+     * Use this instead of delete at the exit: the threads that are still running can call vprint safely
+     * (their messages after the shutdown are not written).
+     */
+    void shutdown()
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (this->end) {
+                return;
+            }
+            this->end = true;
+        }
+        this->cond.notify_one();
+        this->thread.join();
+        if (this->fp) {
+            fflush(this->fp);
+        }
+    }
+
+    void vprint(Level level, const char* format, va_list args)
+    {
+        if (level < this->minLevel || !this->acceptRate(format)) {
+            return;
+        }
+        uint32_t pos = this->head.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &this->slots[pos & (LOGGER_QUEUE_SIZE - 1)];
+            uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+            int32_t diff = (int32_t)(sequence - pos);
+            if (0 == diff) {
+                if (this->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                this->dropped.fetch_add(1, std::memory_order_relaxed); // queue is full
+                return;
+            } else {
+                pos = this->head.load(std::memory_order_relaxed);
+            }
+        }
+        slot->level = level;
+        slot->time = this->clock.load(std::memory_order_relaxed);
+        vsnprintf(slot->text, sizeof(slot->text), format, args);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        if (Level::Error == level) {
+            this->cond.notify_one();
+        }
+    }
+
+    void print(Level level, const char* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        this->vprint(level, format, args);
+        va_end(args);
+    }
+
+  private:
+    Rate* findRate(const char* format)
+    {
+        // one slot per format (call site): the slot is never reused by the other formats
+        uint32_t index = (uint32_t)((uintptr_t)format >> 3);
+        for (int i = 0; i < LOGGER_RATE_TABLE_SIZE; i++, index++) {
+            auto& rate = this->rates[index & (LOGGER_RATE_TABLE_SIZE - 1)];
+            const char* current = rate.format.load(std::memory_order_acquire);
+            if (current == format) {
+                return &rate;
+            }
+            if (!current) {
+                if (rate.format.compare_exchange_strong(current, format, std::memory_order_acq_rel) || current == format) {
+                    return &rate;
+                }
+            }
+        }
+        return nullptr; // the table is full: not limited
+    }
+
+    bool acceptRate(const char* format)
+    {
+        Rate* rate = this->findRate(format);
+        if (!rate) {
+            return true;
+        }
+        int64_t now = this->clock.load(std::memory_order_relaxed);
+        if (rate->second.exchange(now, std::memory_order_relaxed) != now) {
+            rate->count.store(0, std::memory_order_relaxed);
+        }
+        if (LOGGER_RATE_LIMIT <= rate->count.fetch_add(1, std::memory_order_relaxed)) {
+            rate->suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    Slot* peek()
+    {
+        Slot* slot = &this->slots[this->tail & (LOGGER_QUEUE_SIZE - 1)];
+        if (slot->sequence.load(std::memory_order_acquire) != this->tail + 1) {
+            return nullptr;
+        }
+        return slot;
+    }
+
+    void pop(Slot* slot)
+    {
+        slot->sequence.store(this->tail + LOGGER_QUEUE_SIZE, std::memory_order_release);
+        this->tail++;
+    }
+
+    static const char* levelTag(Level level)
+    {
+        switch (level) {
+            case Level::Debug: return "[D] ";
+            case Level::Warn: return "[W] ";
+            case Level::Error: return "[E] ";
+            default: return "";
+        }
+    }
+
+    void updatePrefix(int64_t t)
+    {
+        if (t == this->prefixTime) {
+            return;
+        }
+        this->prefixTime = t;
+        time_t tt = (time_t)t;
+        struct tm tm;
+#ifdef _WIN32
+        localtime_s(&tm, &tt);
+#else
+        localtime_r(&tt, &tm);
+#endif
+        snprintf(this->prefix, sizeof(this->prefix), "%04d.%02d.%02d %02d:%02d:%02d ",
+                 tm.tm_year + 1900,
+                 tm.tm_mon + 1,
+                 tm.tm_mday,
+                 tm.tm_hour,
+                 tm.tm_min,
+                 tm.tm_sec);
+    }
+
+    void rotate()
+    {
+        if (this->fileSize < LOGGER_MAX_FILE_SIZE) {
+            return;
+        }
+        fclose(this->fp);
+        remove(LOGGER_ROTATED_FILE);
+        rename(LOGGER_FILE, LOGGER_ROTATED_FILE);
+        this->fp = fopen(LOGGER_FILE, "a");
+        this->fileSize = 0;
+    }
+
+    void drain()
+    {
+        if (!this->fp) {
+            while (Slot* slot = this->peek()) this->pop(slot);
+            return;
+        }
+        bool written = false;
+        while (Slot* slot = this->peek()) {
+            if (this->crashed.load(std::memory_order_acquire)) {
+                return; // the crash handler takes over the queue
+            }
+            this->updatePrefix(slot->time);
+            int len = fprintf(this->fp, "%s%s%s\n", this->prefix, levelTag(slot->level), slot->text);
+            this->pop(slot);
+            if (0 < len) {
+                this->fileSize += len;
+            }
+            written = true;
+            this->rotate();
+            if (!this->fp) {
+                return;
+            }
+        }
+        int64_t now = this->clock.load(std::memory_order_relaxed);
+        for (auto& rate : this->rates) {
+            if (!rate.format.load(std::memory_order_acquire)) {
+                continue;
+            }
+            if (this->end || rate.second.load(std::memory_order_relaxed) != now) {
+                int suppressed = rate.suppressed.exchange(0, std::memory_order_relaxed);
+                if (0 < suppressed) {
+                    this->fileSize += fprintf(this->fp, "%s[W] (suppressed %d messages: %.64s)\n", this->prefix, suppressed, rate.format.load(std::memory_order_relaxed));
+                    written = true;
+                }
+            }
+        }
+        uint32_t dropped = this->dropped.exchange(0, std::memory_order_relaxed);
+        if (0 < dropped) {
+            this->fileSize += fprintf(this->fp, "%s[W] (dropped %u messages: queue full)\n", this->prefix, dropped);
+            written = true;
+        }
+        if (written) {
+            fflush(this->fp);
+        }
+    }
+
+    void main()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (!this->end) {
+            this->cond.wait_for(lock, std::chrono::milliseconds(LOGGER_FLUSH_INTERVAL_MS));
+            this->clock.store((int64_t)time(nullptr), std::memory_order_relaxed);
+            this->lockedDrain();
+        }
+        this->lockedDrain();
+    }
+
+    void lockedDrain()
+    {
+        if (this->consuming.exchange(true, std::memory_order_acquire)) {
+            return;
+        }
+        if (!this->crashed.load(std::memory_order_acquire)) {
+            this->drain();
+        }
+        this->consuming.store(false, std::memory_order_release);
+    }
+
+    void installCrashHandler()
+    {
+#ifdef _WIN32
+        SetUnhandledExceptionFilter([](EXCEPTION_POINTERS* e) -> LONG {
+            Logger::crash("unhandled exception");
+            return EXCEPTION_CONTINUE_SEARCH;
+        });
+#else
+        for (int sig : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) {
+            std::signal(sig, [](int sig) {
+                Logger::crash(SIGSEGV == sig ? "SIGSEGV" : SIGBUS == sig ? "SIGBUS" : SIGFPE == sig ? "SIGFPE" : SIGILL == sig ? "SIGILL" : "SIGABRT");
+                std::signal(sig, SIG_DFL);
+                raise(sig);
+            });
+        }
+#endif
+    }
+
+  public:
+    /**
+     * Write the queued messages to the log file without the flush thread (called from the crash handler)
+     */
+    static void crash(const char* reason)
+    {
+        Logger* logger = instance;
+        if (!logger || !logger->fp || logger->crashed.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        // the flush thread leaves the drain at the next message (not owned if the flush thread itself crashed)
+        bool owned = false;
+        for (int i = 0; !owned && i < LOGGER_CRASH_SPIN; i++) {
+            owned = !logger->consuming.exchange(true, std::memory_order_acquire);
+        }
+        int fd = LOGGER_FILENO(logger->fp);
+        if (owned) {
+            fflush(logger->fp);
+            while (Slot* slot = logger->peek()) {
+                LOGGER_WRITE(fd, logger->prefix, strlen(logger->prefix));
+                LOGGER_WRITE(fd, levelTag(slot->level), strlen(levelTag(slot->level)));
+                LOGGER_WRITE(fd, slot->text, strlen(slot->text));
+                LOGGER_WRITE(fd, "\n", 1);
+                logger->pop(slot);
+            }
+        }
+        const char* msg = "Crashed: ";
+        LOGGER_WRITE(fd, msg, strlen(msg));
+        LOGGER_WRITE(fd, reason, strlen(reason));
+        LOGGER_WRITE(fd, "\n", 1);
+    }
+};
+
+Logger* Logger::instance = nullptr;
@@ -0,0 +1,160 @@
+/**
+ * VGS-Zero SDK for Steam - LZ4 block format codec (compressor for pkg2src, decompressor for the runtime)
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5 // the last 5 bytes are always literals
+#define LZ4_MF_LIMIT 12     // the last match starts 12 bytes before the end at the latest
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 16
+
+class LZ4
+{
+  private:
+    static inline uint32_t read32(const uint8_t* ptr)
+    {
+        uint32_t result;
+        memcpy(&result, ptr, 4);
+        return result;
+    }
+
+    static void writeLength(std::vector<uint8_t>& out, size_t length)
+    {
+        while (255 <= length) {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back((uint8_t)length);
+    }
+
+    static void writeSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+    {
+        uint8_t token = (uint8_t)((15 <= literalLength ? 15 : literalLength) << 4);
+        if (matchLength) {
+            size_t code = matchLength - LZ4_MIN_MATCH;
+            token |= 15 <= code ? 15 : (uint8_t)code;
+        }
+        out.push_back(token);
+        if (15 <= literalLength) {
+            writeLength(out, literalLength - 15);
+        }
+        out.insert(out.end(), literals, literals + literalLength);
+        if (matchLength) {
+            out.push_back((uint8_t)(offset & 0xFF));
+            out.push_back((uint8_t)(offset >> 8));
+            if (15 <= matchLength - LZ4_MIN_MATCH) {
+                writeLength(out, matchLength - LZ4_MIN_MATCH - 15);
+            }
+        }
+    }
+
+  public:
+    /**
+     * Compress with the greedy matching (build time only)
+     */
+    static std::vector<uint8_t> compress(const uint8_t* src, size_t size)
+    {
+        std::vector<uint8_t> out;
+        out.reserve(size + size / 255 + 16);
+        std::vector<int64_t> table(1 << LZ4_HASH_BITS, -1);
+        size_t anchor = 0;
+        size_t pos = 0;
+        if (LZ4_MF_LIMIT < size) {
+            size_t limit = size - LZ4_MF_LIMIT;
+            while (pos < limit) {
+                uint32_t sequence = read32(&src[pos]);
+                uint32_t hash = (sequence * 2654435761U) >> (32 - LZ4_HASH_BITS);
+                int64_t ref = table[hash];
+                table[hash] = (int64_t)pos;
+                if (ref < 0 || LZ4_MAX_OFFSET < pos - ref || read32(&src[ref]) != sequence) {
+                    pos++;
+                    continue;
+                }
+                size_t length = LZ4_MIN_MATCH;
+                size_t maxLength = size - LZ4_LAST_LITERALS - pos;
+                while (length < maxLength && src[ref + length] == src[pos + length]) {
+                    length++;
+                }
+                writeSequence(out, &src[anchor], pos - anchor, pos - ref, length);
+                pos += length;
+                anchor = pos;
+            }
+        }
+        writeSequence(out, &src[anchor], size - anchor, 0, 0);
+        return out;
+    }
+
+    /**
+     * Decompress to the buffer of the exact original size (false: broken data)
+     */
+    static bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+    {
+        const uint8_t* ip = src;
+        const uint8_t* iend = src + srcSize;
+        uint8_t* op = dst;
+        uint8_t* oend = dst + dstSize;
+        while (ip < iend) {
+            uint8_t token = *ip++;
+            size_t length = token >> 4;
+            if (15 == length) {
+                uint8_t b;
+                do {
+                    if (iend <= ip) {
+                        return false;
+                    }
+                    b = *ip++;
+                    length += b;
+                } while (255 == b);
+            }
+            if ((size_t)(iend - ip) < length || (size_t)(oend - op) < length) {
+                return false;
+            }
+            memcpy(op, ip, length);
+            ip += length;
+            op += length;
+            if (iend == ip) {
+                break; // the last literals
+            }
+            if (iend - ip < 2) {
+                return false;
+            }
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            if (0 == offset || (size_t)(op - dst) < offset) {
+                return false;
+            }
+            length = token & 15;
+            if (15 == length) {
+                uint8_t b;
+                do {
+                    if (iend <= ip) {
+                        return false;
+                    }
+                    b = *ip++;
+                    length += b;
+                } while (255 == b);
+            }
+            length += LZ4_MIN_MATCH;
+            if ((size_t)(oend - op) < length) {
+                return false;
+            }
+            const uint8_t* match = op - offset;
+            if (length <= offset) {
+                memcpy(op, match, length);
+                op += length;
+            } else {
+                while (length--) {
+                    *op++ = *match++; // overlapped copy (run length)
+                }
+            }
+        }
+        return op == oend;
+    }
+};
@@ -0,0 +1,255 @@
+/**
+ * VGS-Zero SDK for Steam - Memory footprint report and allocation audit of the main loop (-memstats)
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * Counted allocations:
+ * - SDL_malloc/calloc/realloc: hooked by SDL_SetMemoryFunctions only while -memstats is specified
+ * - operator new/new[]: hooked only in the builds with MEMSTATS defined (make MEMSTATS=1)
+ *   The replacement costs a relaxed atomic load per allocation even without -memstats, so the release builds do not have it.
+ *   NOTE: it replaces the global operator new/delete, so include this header from only one translation unit.
+ * Not counted: malloc from C code and the libraries (vgstone.c, libc, Steam API) and the aligned operator new.
+ * The heap figure (mallinfo2 / malloc_zone_statistics) includes them.
+ */
+#pragma once
+#include "SDL.h"
+#include <atomic>
+#include <fcntl.h>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef LINUX
+#include <malloc.h>
+#endif
+#ifdef DARWIN
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+#endif
+
+#define MEM_STATS_WARMUP_FRAMES 300 // allocations after this frame are reported as errors
+#define MEM_STATS_CALLERS 8
+
+class MemStats
+{
+  private:
+    static std::atomic<bool> enabled;
+    static std::atomic<bool> auditing;
+    static std::atomic<uint64_t> allocations;
+    static std::atomic<uint64_t> allocatedBytes;
+    static thread_local bool loopThread;
+    static uint64_t loopAllocations; // written by the main loop thread only
+    static void* loopCallers[MEM_STATS_CALLERS];
+    static SDL_malloc_func sdlMalloc;
+    static SDL_calloc_func sdlCalloc;
+    static SDL_realloc_func sdlRealloc;
+    static SDL_free_func sdlFree;
+    void (*putlog)(const char*, ...);
+    int frames;
+
+  public:
+    MemStats(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+        this->frames = 0;
+    }
+
+    /**
+     * Start counting (call from the main loop thread before SDL_Init)
+     */
+    void start()
+    {
+        loopThread = true;
+        SDL_GetMemoryFunctions(&sdlMalloc, &sdlCalloc, &sdlRealloc, &sdlFree);
+        SDL_SetMemoryFunctions(
+            [](size_t size) -> void* {
+                record(size, __builtin_return_address(0));
+                return sdlMalloc(size);
+            },
+            [](size_t count, size_t size) -> void* {
+                record(count * size, __builtin_return_address(0));
+                return sdlCalloc(count, size);
+            },
+            [](void* ptr, size_t size) -> void* {
+                record(size, __builtin_return_address(0));
+                return sdlRealloc(ptr, size);
+            },
+            [](void* ptr) { sdlFree(ptr); });
+        enabled.store(true, std::memory_order_relaxed);
+        if (!isNewHooked()) {
+            putlog("memstats: operator new is not counted in this build (make MEMSTATS=1 for the allocation audit)");
+        }
+        this->milestone("startup");
+    }
+
+    static inline void record(size_t size, void* caller)
+    {
+        if (!enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        if (loopThread && auditing.load(std::memory_order_relaxed)) {
+            if (loopAllocations < MEM_STATS_CALLERS) {
+                loopCallers[loopAllocations] = caller;
+            }
+            loopAllocations++;
+        }
+    }
+
+    static constexpr bool isNewHooked()
+    {
+#ifdef MEMSTATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void milestone(const char* name)
+    {
+        if (!enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        putlog("memstats(%s): RSS %.1fMB, heap %.1fMB, %llu allocations (%.1fKB)",
+               name,
+               rss() / 1048576.0,
+               heap() / 1048576.0,
+               (unsigned long long)allocations.load(std::memory_order_relaxed),
+               allocatedBytes.load(std::memory_order_relaxed) / 1024.0);
+    }
+
+    /**
+     * Called at the end of each frame: the audit starts after the warm-up frames
+     */
+    inline void frame()
+    {
+        if (!enabled.load(std::memory_order_relaxed) || MEM_STATS_WARMUP_FRAMES < this->frames) {
+            return;
+        }
+        if (MEM_STATS_WARMUP_FRAMES == ++this->frames) {
+            this->milestone("steady state");
+            auditing.store(true, std::memory_order_relaxed);
+            this->frames++;
+        }
+    }
+
+    /**
+     * Stop the audit and report the result (false: the main loop allocated after the warm-up)
+     */
+    bool finish()
+    {
+        if (!enabled.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        auditing.store(false, std::memory_order_relaxed);
+        this->milestone("exit");
+        if (0 == loopAllocations) {
+            putlog("memstats: no allocation in the main loop after %d frames of warm-up (%s)", MEM_STATS_WARMUP_FRAMES, isNewHooked() ? "SDL and operator new" : "SDL only: operator new is not counted");
+            return true;
+        }
+        putlog("memstats: detected %llu allocations in the main loop after the warm-up", (unsigned long long)loopAllocations);
+        for (int i = 0; i < MEM_STATS_CALLERS && i < (int)loopAllocations; i++) {
+            putlog("- caller[%d]: %p", i, loopCallers[i]);
+        }
+        return false;
+    }
+
+  private:
+    static size_t rss()
+    {
+#if defined(DARWIN)
+        mach_task_basic_info_data_t info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (KERN_SUCCESS != task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count)) {
+            return 0;
+        }
+        return info.resident_size;
+#else
+        char buf[128];
+        int fd = open("/proc/self/statm", O_RDONLY);
+        if (fd < 0) {
+            return 0;
+        }
+        auto len = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (len <= 0) {
+            return 0;
+        }
+        buf[len] = 0;
+        unsigned long size, resident;
+        if (2 != sscanf(buf, "%lu %lu", &size, &resident)) {
+            return 0;
+        }
+        return (size_t)resident * sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    static size_t heap()
+    {
+#if defined(DARWIN)
+        malloc_statistics_t stats;
+        malloc_zone_statistics(nullptr, &stats);
+        return stats.size_in_use;
+#elif defined(__GLIBC__) && (2 < __GLIBC__ || (2 == __GLIBC__ && 33 <= __GLIBC_MINOR__))
+        return mallinfo2().uordblks;
+#else
+        return 0;
+#endif
+    }
+};
+
+std::atomic<bool> MemStats::enabled(false);
+std::atomic<bool> MemStats::auditing(false);
+std::atomic<uint64_t> MemStats::allocations(0);
+std::atomic<uint64_t> MemStats::allocatedBytes(0);
+thread_local bool MemStats::loopThread = false;
+uint64_t MemStats::loopAllocations = 0;
+void* MemStats::loopCallers[MEM_STATS_CALLERS];
+SDL_malloc_func MemStats::sdlMalloc = nullptr;
+SDL_calloc_func MemStats::sdlCalloc = nullptr;
+SDL_realloc_func MemStats::sdlRealloc = nullptr;
+SDL_free_func MemStats::sdlFree = nullptr;
+
+#ifdef MEMSTATS
+// counting operator new (the cost is a relaxed load while -memstats is not specified)
+void* operator new(size_t size)
+{
+    MemStats::record(size, __builtin_return_address(0));
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    MemStats::record(size, __builtin_return_address(0));
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    MemStats::record(size, __builtin_return_address(0));
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    MemStats::record(size, __builtin_return_address(0));
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+#endif
@@ -0,0 +1,307 @@
+/**
+ * VGS-Zero SDK for Steam - Prometheus metrics endpoint on a Unix domain socket for Linux and macOS
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * usage (enable "automation.metrics" in config.json):
+ *   curl --unix-socket metrics.sock http://localhost/metrics
+ *
+ * The producers (main loop, audio callback and save writer) only update atomics,
+ * and the server thread only reads them, so a slow scraper never blocks the frame loop.
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#define METRICS_FRAME_BUCKETS 13
+#define METRICS_POLL_MS 200
+#define METRICS_FPS_FRAMES 60
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS: SO_NOSIGPIPE is set to the client socket instead
+#endif
+
+class Metrics
+{
+  private:
+    // upper bounds of the frame interval histogram (microseconds)
+    const int64_t bucketLimits[METRICS_FRAME_BUCKETS] = {1000, 2000, 4000, 8000, 12000, 16000, 17000, 18000, 20000, 25000, 33000, 50000, 100000};
+
+    void (*putlog)(const char*, ...);
+    std::string path;
+    int fd;
+    std::thread thread;
+    std::atomic<bool> end;
+
+    // main loop thread
+    std::chrono::steady_clock::time_point prevFrame;
+    std::chrono::steady_clock::time_point fpsStart;
+    int fpsFrames;
+
+    // audio thread
+    std::chrono::steady_clock::time_point prevAudio;
+
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> frameBuckets[METRICS_FRAME_BUCKETS + 1]; // +Inf
+    std::atomic<uint64_t> frameSumUs;
+    std::atomic<uint32_t> fpsX100;
+    std::atomic<uint64_t> droppedFrames;
+    std::atomic<uint64_t> audioCallbacks;
+    std::atomic<uint64_t> audioUnderruns;
+    std::atomic<uint64_t> saves;
+    std::atomic<int64_t> saveLatencyUs;
+    std::atomic<int64_t> saveLatencyMaxUs;
+    std::atomic<int64_t> steamRunCallbacksUs;
+    std::atomic<int64_t> steamRunCallbacksMaxUs;
+
+  public:
+    Metrics(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+        this->fd = -1;
+        this->end.store(false);
+        this->fpsFrames = 0;
+        this->frames.store(0);
+        for (auto& bucket : this->frameBuckets) {
+            bucket.store(0);
+        }
+        this->frameSumUs.store(0);
+        this->fpsX100.store(0);
+        this->droppedFrames.store(0);
+        this->audioCallbacks.store(0);
+        this->audioUnderruns.store(0);
+        this->saves.store(0);
+        this->saveLatencyUs.store(0);
+        this->saveLatencyMaxUs.store(0);
+        this->steamRunCallbacksUs.store(0);
+        this->steamRunCallbacksMaxUs.store(0);
+    }
+
+    ~Metrics()
+    {
+        if (this->fd < 0) {
+            return;
+        }
+        this->end.store(true);
+        this->thread.join();
+        close(this->fd);
+        unlink(this->path.c_str());
+    }
+
+    bool start(const char* path)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (sizeof(addr.sun_path) <= strlen(path)) {
+            putlog("Metrics socket path is too long: %s", path);
+            return false;
+        }
+        strcpy(addr.sun_path, path);
+        this->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (this->fd < 0) {
+            putlog("Metrics socket create failed");
+            return false;
+        }
+        unlink(path); // remove the stale socket of the previous process
+        if (0 != bind(this->fd, (struct sockaddr*)&addr, sizeof(addr)) || 0 != listen(this->fd, 4)) {
+            putlog("Metrics socket bind failed: %s", path);
+            close(this->fd);
+            this->fd = -1;
+            return false;
+        }
+        this->path = path;
+        auto now = std::chrono::steady_clock::now();
+        this->prevFrame = now;
+        this->fpsStart = now;
+        this->prevAudio = now;
+        this->thread = std::thread([this]() { this->main(); });
+        putlog("Metrics endpoint: %s", path);
+        return true;
+    }
+
+    /**
+     * Called at the end of each frame from the main loop (workUs: processing time before the sleep)
+     */
+    void frame(int workUs, int budgetUs)
+    {
+        auto now = std::chrono::steady_clock::now();
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(now - this->prevFrame).count();
+        this->prevFrame = now;
+        int bucket = 0;
+        while (bucket < METRICS_FRAME_BUCKETS && this->bucketLimits[bucket] < us) {
+            bucket++;
+        }
+        this->frameBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        this->frameSumUs.fetch_add(us, std::memory_order_relaxed);
+        this->frames.fetch_add(1, std::memory_order_relaxed);
+        if (budgetUs < workUs) {
+            this->droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (METRICS_FPS_FRAMES <= ++this->fpsFrames) {
+            std::chrono::duration<double> elapsed = now - this->fpsStart;
+            this->fpsX100.store((uint32_t)(this->fpsFrames * 100 / elapsed.count()), std::memory_order_relaxed);
+            this->fpsStart = now;
+            this->fpsFrames = 0;
+        }
+    }
+
+    /**
+     * Called from the audio callback: a callback later than 1.5 periods is counted as an underrun
+     * (bytesPerSecond: of the obtained audio spec)
+     */
+    void audio(int bytes, int bytesPerSecond)
+    {
+        auto now = std::chrono::steady_clock::now();
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(now - this->prevAudio).count();
+        this->prevAudio = now;
+        int64_t periodUs = (int64_t)bytes * 1000000 / bytesPerSecond;
+        if (0 < this->audioCallbacks.fetch_add(1, std::memory_order_relaxed) && periodUs * 3 / 2 < us) {
+            this->audioUnderruns.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void save(int64_t latencyUs)
+    {
+        this->saves.fetch_add(1, std::memory_order_relaxed);
+        this->saveLatencyUs.store(latencyUs, std::memory_order_relaxed);
+        if (this->saveLatencyMaxUs.load(std::memory_order_relaxed) < latencyUs) {
+            this->saveLatencyMaxUs.store(latencyUs, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Duration of SteamAPI_RunCallbacks in the main loop (not the latency from the event to the callback)
+     */
+    void steamRunCallbacks(int64_t us)
+    {
+        this->steamRunCallbacksUs.store(us, std::memory_order_relaxed);
+        if (this->steamRunCallbacksMaxUs.load(std::memory_order_relaxed) < us) {
+            this->steamRunCallbacksMaxUs.store(us, std::memory_order_relaxed);
+        }
+    }
+
+  private:
+    void main()
+    {
+        while (!this->end.load()) {
+            struct pollfd pfd = {this->fd, POLLIN, 0};
+            if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) {
+                continue;
+            }
+            int client = accept(this->fd, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+#ifdef SO_NOSIGPIPE
+            int on = 1;
+            setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+            this->serve(client);
+            close(client);
+        }
+    }
+
+    void serve(int client)
+    {
+        // accept both of a plain connection (e.g., nc -U) and an HTTP request (e.g., curl --unix-socket)
+        char request[1024];
+        struct pollfd pfd = {client, POLLIN, 0};
+        ssize_t len = 0 < poll(&pfd, 1, METRICS_POLL_MS) ? recv(client, request, sizeof(request) - 1, 0) : 0;
+        bool http = 3 <= len && 0 == memcmp(request, "GET", 3);
+        std::string body = this->format();
+        std::string response;
+        if (http) {
+            char header[128];
+            snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\n\r\n", (int)body.size());
+            response = header;
+        }
+        response += body;
+        const char* ptr = response.c_str();
+        size_t left = response.size();
+        while (0 < left) {
+            auto sent = send(client, ptr, left, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                return;
+            }
+            ptr += sent;
+            left -= sent;
+        }
+    }
+
+    static void append(std::string& out, const char* format, ...)
+    {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        out += buf;
+    }
+
+    std::string format()
+    {
+        std::string out;
+        uint64_t frames = this->frames.load(std::memory_order_relaxed);
+        append(out, "# TYPE vgs0_frames_total counter\nvgs0_frames_total %llu\n", (unsigned long long)frames);
+        append(out, "# TYPE vgs0_fps gauge\nvgs0_fps %.2f\n", this->fpsX100.load(std::memory_order_relaxed) / 100.0);
+
+        // frame interval: histogram and the percentiles estimated from it
+        uint64_t counts[METRICS_FRAME_BUCKETS + 1];
+        uint64_t total = 0;
+        for (int i = 0; i <= METRICS_FRAME_BUCKETS; i++) {
+            counts[i] = this->frameBuckets[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        append(out, "# TYPE vgs0_frame_seconds histogram\n");
+        uint64_t cumulative = 0;
+        for (int i = 0; i < METRICS_FRAME_BUCKETS; i++) {
+            cumulative += counts[i];
+            append(out, "vgs0_frame_seconds_bucket{le=\"%g\"} %llu\n", this->bucketLimits[i] / 1000000.0, (unsigned long long)cumulative);
+        }
+        append(out, "vgs0_frame_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)total);
+        append(out, "vgs0_frame_seconds_sum %g\n", this->frameSumUs.load(std::memory_order_relaxed) / 1000000.0);
+        append(out, "vgs0_frame_seconds_count %llu\n", (unsigned long long)total);
+        append(out, "# TYPE vgs0_frame_seconds_percentile gauge\n");
+        for (int p : {50, 90, 99}) {
+            append(out, "vgs0_frame_seconds_percentile{p=\"%d\"} %g\n", p, this->percentile(counts, total, p) / 1000000.0);
+        }
+
+        append(out, "# TYPE vgs0_dropped_frames_total counter\nvgs0_dropped_frames_total %llu\n", (unsigned long long)this->droppedFrames.load(std::memory_order_relaxed));
+        append(out, "# TYPE vgs0_audio_callbacks_total counter\nvgs0_audio_callbacks_total %llu\n", (unsigned long long)this->audioCallbacks.load(std::memory_order_relaxed));
+        append(out, "# TYPE vgs0_audio_underruns_total counter\nvgs0_audio_underruns_total %llu\n", (unsigned long long)this->audioUnderruns.load(std::memory_order_relaxed));
+        append(out, "# TYPE vgs0_saves_total counter\nvgs0_saves_total %llu\n", (unsigned long long)this->saves.load(std::memory_order_relaxed));
+        append(out, "# TYPE vgs0_save_latency_seconds gauge\nvgs0_save_latency_seconds %g\n", this->saveLatencyUs.load(std::memory_order_relaxed) / 1000000.0);
+        append(out, "# TYPE vgs0_save_latency_max_seconds gauge\nvgs0_save_latency_max_seconds %g\n", this->saveLatencyMaxUs.load(std::memory_order_relaxed) / 1000000.0);
+        append(out, "# HELP vgs0_steam_run_callbacks_seconds Duration of the last SteamAPI_RunCallbacks call\n");
+        append(out, "# TYPE vgs0_steam_run_callbacks_seconds gauge\nvgs0_steam_run_callbacks_seconds %g\n", this->steamRunCallbacksUs.load(std::memory_order_relaxed) / 1000000.0);
+        append(out, "# TYPE vgs0_steam_run_callbacks_max_seconds gauge\nvgs0_steam_run_callbacks_max_seconds %g\n", this->steamRunCallbacksMaxUs.load(std::memory_order_relaxed) / 1000000.0);
+        return out;
+    }
+
+    // upper bound of the bucket which contains the percentile (the last finite bound for +Inf)
+    int64_t percentile(const uint64_t* counts, uint64_t total, int p)
+    {
+        if (0 == total) {
+            return 0;
+        }
+        uint64_t target = (total * p + 99) / 100;
+        uint64_t cumulative = 0;
+        for (int i = 0; i < METRICS_FRAME_BUCKETS; i++) {
+            cumulative += counts[i];
+            if (target <= cumulative) {
+                return this->bucketLimits[i];
+            }
+        }
+        return this->bucketLimits[METRICS_FRAME_BUCKETS - 1];
+    }
+};
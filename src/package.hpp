@@ -0,0 +1,326 @@
+/**
+ * VGS-Zero SDK for Steam - game.pkg parser
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * v1 (VGS0PKG): the sections are used in place
+ *   "VGS0PKG\0", { int32 size, data } x (rom, bgm, se)
+ *
+ * v2 (VGS0PK2, pkg2src and pkgpack): PackageHeaderV2, PackageSectionV2 x sectionCount, payloads
+ *   - every payload starts at a multiple of the alignment (4096) from the top of the package
+ *     (a package with another alignment, a misaligned payload or a section type listed twice is rejected)
+ *   - the directory and every payload are verified with CRC32C before the emulator loads them
+ *     (with the CRC32C instructions if the CPU supports them)
+ *   - raw payloads are used in place, LZ4 payloads are decompressed into the buffers
+ *   - both run on the calling thread: a thread per section costs more to start than it saves
+ *     for the package sizes of VGS-Zero (the package is loaded on a startup worker thread anyway)
+ *   - unknown section types are skipped (for the future extensions)
+ *   - the layout of the embedded package is checked at build time (gamepkg.h made by pkg2src)
+ */
+#pragma once
+#include "crc32c.hpp"
+#include "lz4.hpp"
+#include <chrono>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#define PACKAGE_MIN_ROM_SIZE (8 + 8192)
+#define PACKAGE_V2_VERSION 2
+#define PACKAGE_V2_ALIGNMENT 4096
+#define PACKAGE_V2_FLAG_LZ4 0x00000001
+
+struct PackageHeaderV2 {
+    char magic[8];         // "VGS0PK2"
+    uint32_t version;      // PACKAGE_V2_VERSION
+    uint32_t sectionCount; // number of PackageSectionV2 following the header
+    uint32_t alignment;    // PACKAGE_V2_ALIGNMENT
+    uint32_t directoryCrc; // CRC32C of the PackageSectionV2 array
+};
+
+struct PackageSectionV2 {
+    uint32_t type;       // Package::Section
+    uint32_t flags;      // PACKAGE_V2_FLAG_*
+    uint32_t offset;     // payload position from the top of the package
+    uint32_t size;       // original size
+    uint32_t storedSize; // payload size (== size if not compressed)
+    uint32_t crc;        // CRC32C of the payload
+};
+
+class Package
+{
+  public:
+    enum Section {
+        Rom,
+        Bgm,
+        Se,
+        SectionCount,
+    };
+
+    /**
+     * Sections of a v2 package (pkg2src emits the layout of the embedded package as constexpr to gamepkg.h)
+     */
+    struct Layout {
+        struct Entry {
+            uint32_t offset;
+            uint32_t size;
+            uint32_t storedSize;
+            uint32_t flags;
+            uint32_t crc;
+        };
+        char magic[8];
+        Entry section[SectionCount];
+
+        constexpr bool isV2() const
+        {
+            const char expect[8] = {'V', 'G', 'S', '0', 'P', 'K', '2', '\0'};
+            for (int i = 0; i < 8; i++) {
+                if (expect[i] != this->magic[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        constexpr bool fits(size_t packageSize) const
+        {
+            for (int i = 0; i < SectionCount; i++) {
+                const Entry& e = this->section[i];
+                if (packageSize < e.offset || packageSize - e.offset < e.storedSize || 0x7FFFFFFF < e.size) {
+                    return false;
+                }
+                if (0 != e.offset % PACKAGE_V2_ALIGNMENT) {
+                    return false;
+                }
+                if (0 == (e.flags & PACKAGE_V2_FLAG_LZ4) && e.size != e.storedSize) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+  private:
+    struct Payload {
+        const uint8_t* ptr;
+        uint32_t storedSize;
+        bool compressed;
+    };
+
+    void (*putlog)(const char*, ...);
+    const uint8_t* data[SectionCount];
+    int size[SectionCount];
+    std::vector<uint8_t> buffer[SectionCount]; // decompressed sections
+
+    static bool read32(const uint8_t*& ptr, const uint8_t* end, uint32_t* value)
+    {
+        if (end - ptr < 4) {
+            return false;
+        }
+        memcpy(value, ptr, 4);
+        ptr += 4;
+        return true;
+    }
+
+  public:
+    static const char* sectionName(int section)
+    {
+        switch (section) {
+            case Rom: return "game.rom";
+            case Bgm: return "bgm.dat";
+            case Se: return "se.dat";
+            default: return "unknown";
+        }
+    }
+
+    Package(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+        for (int i = 0; i < SectionCount; i++) {
+            this->data[i] = nullptr;
+            this->size[i] = 0;
+        }
+    }
+
+    const void* get(Section section) { return this->size[section] ? this->data[section] : nullptr; }
+    int getSize(Section section) { return this->size[section]; }
+
+    bool open(const void* package, size_t packageSize)
+    {
+        auto ptr = (const uint8_t*)package;
+        auto end = ptr + packageSize;
+        bool result;
+        if (8 <= packageSize && 0 == memcmp(ptr, "VGS0PKG", 8)) {
+            result = this->openV1(ptr + 8, end);
+        } else if (8 <= packageSize && 0 == memcmp(ptr, "VGS0PK2", 8)) {
+            Layout layout;
+            result = this->parseLayout(ptr, packageSize, &layout) && this->openLayout(ptr, layout);
+        } else {
+            putlog("Invalid package!");
+            return false;
+        }
+        if (!result) {
+            return false;
+        }
+        if (this->size[Rom] < PACKAGE_MIN_ROM_SIZE) {
+            putlog("Invalid game.rom size");
+            return false;
+        }
+        this->logSizes();
+        return true;
+    }
+
+    /**
+     * Open the package of the layout checked at build time (only the payloads are verified at runtime)
+     */
+    bool open(const void* package, const Layout& layout)
+    {
+        if (!this->openLayout((const uint8_t*)package, layout)) {
+            return false;
+        }
+        this->logSizes();
+        return true;
+    }
+
+    /**
+     * Read the section directory of a v2 package
+     */
+    bool parseLayout(const void* package, size_t packageSize, Layout* layout)
+    {
+        auto top = (const uint8_t*)package;
+        PackageHeaderV2 header;
+        if (packageSize < sizeof(header) || 0 != memcmp(top, "VGS0PK2", 8)) {
+            putlog("Invalid package! (broken header)");
+            return false;
+        }
+        memcpy(&header, top, sizeof(header));
+        if (PACKAGE_V2_VERSION != header.version) {
+            putlog("Unsupported package version: %u", header.version);
+            return false;
+        }
+        if (PACKAGE_V2_ALIGNMENT != header.alignment) {
+            putlog("Invalid package! (alignment: %u)", header.alignment);
+            return false;
+        }
+        if ((packageSize - sizeof(header)) / sizeof(PackageSectionV2) < header.sectionCount) {
+            putlog("Invalid package! (broken directory)");
+            return false;
+        }
+        size_t directorySize = header.sectionCount * sizeof(PackageSectionV2);
+        if (header.directoryCrc != CRC32C::calc(top + sizeof(header), directorySize)) {
+            putlog("Invalid package! (CRC mismatch: directory)");
+            return false;
+        }
+        memset(layout, 0, sizeof(Layout));
+        memcpy(layout->magic, header.magic, 8);
+        bool listed[SectionCount] = {};
+        for (uint32_t n = 0; n < header.sectionCount; n++) {
+            PackageSectionV2 section;
+            memcpy(&section, top + sizeof(header) + n * sizeof(section), sizeof(section));
+            if (SectionCount <= section.type) {
+                continue;
+            }
+            if (listed[section.type]) {
+                putlog("Invalid package! (duplicated section: %s)", sectionName(section.type));
+                return false;
+            }
+            listed[section.type] = true;
+            if (section.storedSize && section.offset < sizeof(header) + directorySize) {
+                putlog("Invalid package! (section overlaps the directory: %s)", sectionName(section.type));
+                return false;
+            }
+            layout->section[section.type] = {section.offset, section.size, section.storedSize, section.flags, section.crc};
+        }
+        if (!layout->fits(packageSize)) {
+            putlog("Invalid package! (broken section)");
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    bool openV1(const uint8_t* ptr, const uint8_t* end)
+    {
+        for (int i = 0; i < SectionCount; i++) {
+            uint32_t sectionSize;
+            if (!read32(ptr, end, &sectionSize) || (size_t)(end - ptr) < sectionSize || 0x7FFFFFFF < sectionSize) {
+                putlog("Invalid package! (broken section: %d)", i);
+                return false;
+            }
+            this->data[i] = ptr;
+            this->size[i] = (int)sectionSize;
+            ptr += sectionSize;
+        }
+        return true;
+    }
+
+    void logSizes()
+    {
+        putlog("- game.rom size: %d", this->size[Rom]);
+        putlog("- bgm.dat size: %d", this->size[Bgm]);
+        putlog("- se.dat size: %d", this->size[Se]);
+    }
+
+    bool openLayout(const uint8_t* top, const Layout& layout)
+    {
+        Payload payload[SectionCount];
+        uint32_t crc[SectionCount];
+        for (int i = 0; i < SectionCount; i++) {
+            payload[i].ptr = top + layout.section[i].offset;
+            payload[i].storedSize = layout.section[i].storedSize;
+            payload[i].compressed = 0 != (layout.section[i].flags & PACKAGE_V2_FLAG_LZ4);
+            crc[i] = layout.section[i].crc;
+            this->size[i] = (int)layout.section[i].size;
+        }
+
+        // verify the payloads before anything is passed to the emulator
+        auto start = std::chrono::steady_clock::now();
+        bool verified[SectionCount];
+        size_t total = 0;
+        for (int i = 0; i < SectionCount; i++) {
+            verified[i] = 0 == crc[i];
+            if (payload[i].storedSize) {
+                verified[i] = crc[i] == CRC32C::calc(payload[i].ptr, payload[i].storedSize);
+                total += payload[i].storedSize;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double mbps = 0 < elapsed.count() ? total / elapsed.count() / 1048576 : 0;
+        putlog("Verified package: %d bytes in %.3fms (%.1fMB/s, CRC32C: %s)", (int)total, elapsed.count() * 1000, mbps, CRC32C::implementation());
+        for (int i = 0; i < SectionCount; i++) {
+            if (!verified[i]) {
+                putlog("Invalid package! (CRC mismatch: %s)", sectionName(i));
+                return false;
+            }
+        }
+        return this->load(payload);
+    }
+
+    // raw payloads are used in place, the compressed payloads are decompressed directly into the buffers passed to VGS0
+    bool load(const Payload* payload)
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t total = 0;
+        size_t totalCompressed = 0;
+        bool result = true;
+        for (int i = 0; i < SectionCount; i++) {
+            if (!payload[i].compressed) {
+                this->data[i] = payload[i].ptr;
+                continue;
+            }
+            this->buffer[i].resize(this->size[i]);
+            this->data[i] = this->buffer[i].data();
+            if (!LZ4::decompress(payload[i].ptr, payload[i].storedSize, this->buffer[i].data(), this->buffer[i].size())) {
+                putlog("Invalid package! (decompress failed: %s)", sectionName(i));
+                result = false;
+            }
+            total += this->buffer[i].size();
+            totalCompressed += payload[i].storedSize;
+        }
+        if (totalCompressed) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            putlog("Decompressed package: %d -> %d bytes in %.2fms", (int)totalCompressed, (int)total, elapsed.count() * 1000);
+        }
+        return result;
+    }
+};
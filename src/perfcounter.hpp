@@ -0,0 +1,166 @@
+/**
+ * VGS-Zero SDK for Steam - Hardware performance counters per frame stage (Linux only)
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#ifdef LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define PERF_COUNTER_REPORT_FRAMES 600
+
+class PerfCounter
+{
+  public:
+    enum Stage {
+        Tick,
+        Convert,
+        Upload,
+        StageCount,
+    };
+
+  private:
+    enum Counter {
+        Cycles,
+        Instructions,
+        CacheMisses,
+        BranchMisses,
+        CounterCount,
+    };
+
+    void (*putlog)(const char*, ...);
+    int fd[CounterCount];
+    bool enabled;
+    uint64_t start[CounterCount];
+    uint64_t total[StageCount][CounterCount];
+    uint64_t frames;
+
+  public:
+    PerfCounter(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+        this->enabled = false;
+        this->frames = 0;
+        for (int i = 0; i < CounterCount; i++) {
+            this->fd[i] = -1;
+        }
+        memset(this->start, 0, sizeof(this->start));
+        memset(this->total, 0, sizeof(this->total));
+    }
+
+    ~PerfCounter()
+    {
+#ifdef LINUX
+        for (int i = 0; i < CounterCount; i++) {
+            if (0 <= this->fd[i]) {
+                close(this->fd[i]);
+            }
+        }
+#endif
+    }
+
+    /**
+     * Open the counters for the calling thread (= emulation thread)
+     */
+    bool open()
+    {
+#ifdef LINUX
+        const uint64_t config[CounterCount] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+        for (int i = 0; i < CounterCount; i++) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = config[i];
+            attr.disabled = 0 == i ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            this->fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, 0 == i ? -1 : this->fd[0], 0);
+            if (this->fd[i] < 0) {
+                putlog("perf_event_open failed (counter=%d): check /proc/sys/kernel/perf_event_paranoid", i);
+                return false;
+            }
+        }
+        ioctl(this->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(this->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        this->enabled = true;
+        putlog("Hardware performance counters enabled");
+        return true;
+#else
+        putlog("Hardware performance counters are not supported on this platform");
+        return false;
+#endif
+    }
+
+    inline void begin()
+    {
+        if (this->enabled) {
+            this->read(this->start);
+        }
+    }
+
+    inline void end(Stage stage)
+    {
+        if (!this->enabled) {
+            return;
+        }
+        uint64_t now[CounterCount];
+        this->read(now);
+        for (int i = 0; i < CounterCount; i++) {
+            this->total[stage][i] += now[i] - this->start[i];
+        }
+    }
+
+    void frame()
+    {
+        if (!this->enabled) {
+            return;
+        }
+        this->frames++;
+        if (PERF_COUNTER_REPORT_FRAMES <= this->frames) {
+            this->report();
+        }
+    }
+
+  private:
+    void read(uint64_t* values)
+    {
+#ifdef LINUX
+        uint64_t buf[1 + CounterCount];
+        if ((ssize_t)sizeof(buf) != ::read(this->fd[0], buf, sizeof(buf)) || CounterCount != buf[0]) {
+            memset(values, 0, sizeof(uint64_t) * CounterCount);
+            return;
+        }
+        memcpy(values, &buf[1], sizeof(uint64_t) * CounterCount);
+#endif
+    }
+
+    void report()
+    {
+        const char* names[StageCount] = {"tick", "convert", "upload"};
+        for (int s = 0; s < StageCount; s++) {
+            auto v = this->total[s];
+            double instructions = v[Instructions] ? (double)v[Instructions] : 1.0;
+            putlog("perf(%s): %.0f cycles/frame, IPC %.2f, cache-miss %.2f/1k-inst, branch-miss %.2f/1k-inst",
+                   names[s],
+                   (double)v[Cycles] / this->frames,
+                   v[Cycles] ? v[Instructions] / (double)v[Cycles] : 0.0,
+                   v[CacheMisses] * 1000.0 / instructions,
+                   v[BranchMisses] * 1000.0 / instructions);
+        }
+        memset(this->total, 0, sizeof(this->total));
+        this->frames = 0;
+    }
+};
@@ -0,0 +1,108 @@
+/**
+ * VGS-Zero SDK for Steam - game.pkg v2 builder (for pkg2src and pkgpack)
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+#pragma once
+#include "crc32c.hpp"
+#include "lz4.hpp"
+#include "package.hpp"
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+class PackageBuilder
+{
+  private:
+    struct Entry {
+        uint32_t type;
+        std::vector<uint8_t> data;
+    };
+    std::vector<Entry> entries;
+
+    static size_t align(size_t position)
+    {
+        return (position + PACKAGE_V2_ALIGNMENT - 1) / PACKAGE_V2_ALIGNMENT * PACKAGE_V2_ALIGNMENT;
+    }
+
+  public:
+    void add(Package::Section type, const void* data, size_t size)
+    {
+        Entry entry;
+        entry.type = type;
+        entry.data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+        this->entries.push_back(std::move(entry));
+    }
+
+    /**
+     * Add the sections of a v1 package (false: not a valid v1 package)
+     */
+    bool addV1(const std::vector<uint8_t>& pkg)
+    {
+        if (pkg.size() < 8 || 0 != memcmp(pkg.data(), "VGS0PKG", 8)) {
+            return false;
+        }
+        size_t pos = 8;
+        for (int i = 0; i < Package::SectionCount; i++) {
+            uint32_t size;
+            if (pkg.size() - pos < 4) {
+                return false;
+            }
+            memcpy(&size, &pkg[pos], 4);
+            pos += 4;
+            if (pkg.size() - pos < size) {
+                return false;
+            }
+            this->add((Package::Section)i, pkg.data() + pos, size);
+            pos += size;
+        }
+        return true;
+    }
+
+    /**
+     * Build the v2 package (compress: LZ4 for each section, kept raw if it does not shrink)
+     */
+    std::vector<uint8_t> build(bool compress, void (*report)(const char* name, size_t size, size_t storedSize))
+    {
+        std::vector<PackageSectionV2> directory(this->entries.size());
+        std::vector<std::vector<uint8_t>> payloads(this->entries.size());
+        size_t position = align(sizeof(PackageHeaderV2) + directory.size() * sizeof(PackageSectionV2));
+        for (size_t i = 0; i < this->entries.size(); i++) {
+            auto& entry = this->entries[i];
+            auto& section = directory[i];
+            payloads[i] = compress ? LZ4::compress(entry.data.data(), entry.data.size()) : entry.data;
+            section.flags = compress ? PACKAGE_V2_FLAG_LZ4 : 0;
+            if (compress && entry.data.size() <= payloads[i].size()) {
+                payloads[i] = entry.data;
+                section.flags = 0;
+            }
+            section.type = entry.type;
+            section.offset = (uint32_t)position;
+            section.size = (uint32_t)entry.data.size();
+            section.storedSize = (uint32_t)payloads[i].size();
+            section.crc = CRC32C::calc(payloads[i].data(), payloads[i].size());
+            position = align(position + payloads[i].size());
+            if (report) {
+                report(Package::sectionName(entry.type), section.size, section.storedSize);
+            }
+        }
+
+        PackageHeaderV2 header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "VGS0PK2", 8);
+        header.version = PACKAGE_V2_VERSION;
+        header.sectionCount = (uint32_t)directory.size();
+        header.alignment = PACKAGE_V2_ALIGNMENT;
+        header.directoryCrc = CRC32C::calc(directory.data(), directory.size() * sizeof(PackageSectionV2));
+
+        std::vector<uint8_t> out(sizeof(header));
+        memcpy(out.data(), &header, sizeof(header));
+        auto dir = (const uint8_t*)directory.data();
+        out.insert(out.end(), dir, dir + directory.size() * sizeof(PackageSectionV2));
+        for (size_t i = 0; i < payloads.size(); i++) {
+            out.resize(directory[i].offset, 0); // padding
+            out.insert(out.end(), payloads[i].begin(), payloads[i].end());
+        }
+        return out;
+    }
+};
@@ -0,0 +1,169 @@
+/**
+ * VGS-Zero SDK for Steam - External game.pkg (-p option) for the development on Linux and macOS
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * PackageFile reads the package into the memory and Package parses the copy in place (no rebuild).
+ * The file is not mapped: a package rewritten or truncated in place would change (or SIGBUS) the running data.
+ * PackageWatcher detects the updates of the package for the hot reload:
+ * - Linux: inotify on the directory (IN_CLOSE_WRITE or IN_MOVED_TO, so the replacement by rename is also detected)
+ * - macOS: the modified time and the size are polled (reloaded after they stop changing)
+ * A v2 package read while it is being written fails the CRC check of Package::open, so the reload keeps the current one
+ * (v1 packages have no CRC: write them to a temporary file and rename it).
+ */
+#pragma once
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#ifdef LINUX
+#include <limits.h>
+#include <sys/inotify.h>
+#endif
+
+class PackageFile
+{
+  private:
+    void (*putlog)(const char*, ...);
+    std::vector<unsigned char> data;
+
+  public:
+    PackageFile(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+    }
+
+    const void* getData() { return this->data.data(); }
+    size_t getSize() { return this->data.size(); }
+
+    bool open(const char* path)
+    {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            putlog("Cannot open %s", path);
+            return false;
+        }
+        struct stat st;
+        if (0 != fstat(fd, &st) || st.st_size < 1) {
+            putlog("Invalid package file: %s", path);
+            close(fd);
+            return false;
+        }
+        this->data.resize((size_t)st.st_size);
+        size_t offset = 0;
+        while (offset < this->data.size()) {
+            auto len = read(fd, &this->data[offset], this->data.size() - offset);
+            if (len <= 0) {
+                break; // error or truncated while reading
+            }
+            offset += len;
+        }
+        close(fd);
+        if (offset != this->data.size()) {
+            putlog("Read error: %s (%d/%d bytes)", path, (int)offset, (int)this->data.size());
+            this->data.clear();
+            return false;
+        }
+        putlog("Loaded %s (%d bytes)", path, (int)this->data.size());
+        return true;
+    }
+};
+
+class PackageWatcher
+{
+  private:
+    void (*putlog)(const char*, ...);
+    std::string name;
+    int fd;
+    struct stat last;
+    struct stat pending;
+    bool hasPending;
+
+    static bool isSameStat(const struct stat& a, const struct stat& b)
+    {
+#ifdef DARWIN
+        return a.st_mtimespec.tv_sec == b.st_mtimespec.tv_sec && a.st_mtimespec.tv_nsec == b.st_mtimespec.tv_nsec && a.st_size == b.st_size && a.st_ino == b.st_ino;
+#else
+        return a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec && a.st_size == b.st_size && a.st_ino == b.st_ino;
+#endif
+    }
+
+  public:
+    PackageWatcher(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+        this->fd = -1;
+        this->hasPending = false;
+        memset(&this->last, 0, sizeof(this->last));
+    }
+
+    ~PackageWatcher()
+    {
+        if (0 <= this->fd) {
+            close(this->fd);
+        }
+    }
+
+    bool start(const char* path)
+    {
+        std::string fullPath = path;
+        auto slash = fullPath.rfind('/');
+        std::string dir = std::string::npos == slash ? "." : fullPath.substr(0, slash + 1);
+        this->name = std::string::npos == slash ? fullPath : fullPath.substr(slash + 1);
+#ifdef LINUX
+        this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (this->fd < 0 || inotify_add_watch(this->fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            putlog("inotify failed: %s", dir.c_str());
+            return false;
+        }
+        putlog("Watching %s (inotify)", path);
+#else
+        this->name = path;
+        stat(path, &this->last);
+        putlog("Watching %s (polling)", path);
+#endif
+        return true;
+    }
+
+    /**
+     * Non-blocking check (true: the package was updated and is ready to reload)
+     */
+    bool changed()
+    {
+#ifdef LINUX
+        if (this->fd < 0) {
+            return false;
+        }
+        bool result = false;
+        char buf[sizeof(struct inotify_event) + NAME_MAX + 1] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t len;
+        while (0 < (len = read(this->fd, buf, sizeof(buf)))) {
+            for (char* ptr = buf; ptr < buf + len;) {
+                auto event = (const struct inotify_event*)ptr;
+                if (event->len && this->name == event->name) {
+                    result = true;
+                }
+                ptr += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        return result;
+#else
+        struct stat st;
+        if (0 != stat(this->name.c_str(), &st) || isSameStat(st, this->last)) {
+            this->hasPending = false;
+            return false;
+        }
+        if (this->hasPending && isSameStat(st, this->pending)) {
+            this->hasPending = false;
+            this->last = st;
+            return true; // unchanged since the previous poll: the writer has finished
+        }
+        this->pending = st;
+        this->hasPending = true;
+        return false;
+#endif
+    }
+};
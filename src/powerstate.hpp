@@ -0,0 +1,203 @@
+/**
+ * VGS-Zero SDK for Steam - Power state machine for Linux and macOS
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * Active ...... emulation at 60fps
+ * Overlay ..... Steam overlay: no emulation, the last frame is presented at 60fps (the overlay is drawn on it)
+ * Unfocused ... no emulation, presented only when exposed (if "power.sleepUnfocused" in config.json)
+ * Minimized ... no emulation, nothing is presented
+ * The battery of /sys/class/power_supply (Linux) is logged at every transition and every "power.batteryLogInterval" seconds.
+ * The average drain is logged only over POWER_BATTERY_AVERAGE_MIN_SEC or more: energy_now is updated coarsely
+ * (e.g. every few seconds, in steps of tens of mWh), so a shorter interval gives a meaningless figure.
+ */
+#pragma once
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define POWER_BATTERY_AVERAGE_MIN_SEC 60
+
+class PowerState
+{
+  public:
+    enum State {
+        Active,
+        Overlay,
+        Unfocused,
+        Minimized,
+    };
+
+  private:
+    void (*putlog)(const char*, ...);
+    bool sleepUnfocused;
+    bool sleepMinimized;
+    int batteryLogInterval;
+    bool overlay;
+    bool focused;
+    bool minimized;
+    State state;
+    std::chrono::steady_clock::time_point stateBegin;
+    std::chrono::steady_clock::time_point batteryLogged;
+    std::chrono::steady_clock::time_point batteryEnergyTime;
+    double batteryEnergy; // Wh at batteryEnergyTime: the base of the average drain (negative: unknown)
+
+    static const char* name(State state)
+    {
+        switch (state) {
+            case Active: return "active";
+            case Overlay: return "overlay";
+            case Unfocused: return "unfocused";
+            case Minimized: return "minimized";
+        }
+        return "unknown";
+    }
+
+#ifdef LINUX
+    // called from the main loop: the paths are built in the stack buffers and read by open/read (no heap allocation)
+    static bool readLine(const char* supply, const char* file, char* buf, size_t size)
+    {
+        char path[512];
+        snprintf(path, sizeof(path), "/sys/class/power_supply/%s/%s", supply, file);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        auto len = read(fd, buf, size - 1);
+        close(fd);
+        if (len <= 0) {
+            return false;
+        }
+        buf[len] = 0;
+        buf[strcspn(buf, "\n")] = 0;
+        return true;
+    }
+
+    static double readValue(const char* supply, const char* file)
+    {
+        char buf[64];
+        return readLine(supply, file, buf, sizeof(buf)) ? atof(buf) : -1;
+    }
+#endif
+
+  public:
+    PowerState(void (*putlog)(const char*, ...), bool sleepUnfocused, bool sleepMinimized, int batteryLogInterval)
+    {
+        this->putlog = putlog;
+        this->sleepUnfocused = sleepUnfocused;
+        this->sleepMinimized = sleepMinimized;
+        this->batteryLogInterval = batteryLogInterval;
+        this->overlay = false;
+        this->focused = true;
+        this->minimized = false;
+        this->state = Active;
+        this->stateBegin = std::chrono::steady_clock::now();
+        this->batteryLogged = this->stateBegin;
+        this->batteryEnergyTime = this->stateBegin;
+        this->batteryEnergy = -1;
+    }
+
+    void setOverlay(bool overlay) { this->overlay = overlay; }
+    void setFocused(bool focused) { this->focused = focused; }
+    void setMinimized(bool minimized) { this->minimized = minimized; }
+    inline State get() { return this->state; }
+    inline bool isSaving() { return Active != this->state; }
+    inline bool isPresentRequired() { return Overlay == this->state; }
+
+    /**
+     * Wake-up interval of the main loop while saving the power
+     */
+    int getWaitMs()
+    {
+        switch (this->state) {
+            case Overlay: return 16;
+            case Unfocused: return 100;
+            case Minimized: return 250;
+            default: return 0;
+        }
+    }
+
+    /**
+     * Apply the inputs (true: the state is changed)
+     */
+    bool update()
+    {
+        State next = Active;
+        if (this->sleepMinimized && this->minimized) {
+            next = Minimized;
+        } else if (this->overlay) {
+            next = Overlay;
+        } else if (this->sleepUnfocused && !this->focused) {
+            next = Unfocused;
+        }
+        if (next == this->state) {
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - this->stateBegin;
+        putlog("Power state: %s -> %s (%.1fs in %s)", name(this->state), name(next), elapsed.count(), name(this->state));
+        this->state = next;
+        this->stateBegin = now;
+        this->logBattery(true);
+        return true;
+    }
+
+    /**
+     * Log the battery status (called every loop, logged at the interval)
+     */
+    void logBattery(bool force = false)
+    {
+#ifdef LINUX
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - this->batteryLogged;
+        if (!force && (this->batteryLogInterval < 1 || elapsed.count() < this->batteryLogInterval)) {
+            return;
+        }
+        this->batteryLogged = now;
+        DIR* dir = opendir("/sys/class/power_supply");
+        if (!dir) {
+            return;
+        }
+        struct dirent* ent;
+        while (nullptr != (ent = readdir(dir))) {
+            char type[32];
+            if ('.' == ent->d_name[0] || !readLine(ent->d_name, "type", type, sizeof(type)) || 0 != strcmp(type, "Battery")) {
+                continue;
+            }
+            char status[32];
+            if (!readLine(ent->d_name, "status", status, sizeof(status))) {
+                strcpy(status, "Unknown");
+            }
+            double capacity = readValue(ent->d_name, "capacity");
+            double watt = readValue(ent->d_name, "power_now") / 1000000; // uW
+            if (watt < 0) {
+                double current = readValue(ent->d_name, "current_now"); // uA
+                double voltage = readValue(ent->d_name, "voltage_now"); // uV
+                watt = 0 <= current && 0 <= voltage ? current * voltage / 1e12 : -1;
+            }
+            double energy = readValue(ent->d_name, "energy_now") / 1000000; // uWh
+            char drain[64] = "";
+            std::chrono::duration<double> span = now - this->batteryEnergyTime;
+            if (energy < 0 || this->batteryEnergy < 0) {
+                this->batteryEnergy = energy;
+                this->batteryEnergyTime = now;
+            } else if (POWER_BATTERY_AVERAGE_MIN_SEC <= span.count()) {
+                snprintf(drain, sizeof(drain), ", average %.2fW in %.0fs", (this->batteryEnergy - energy) * 3600 / span.count(), span.count());
+                this->batteryEnergy = energy;
+                this->batteryEnergyTime = now;
+            }
+            putlog("Battery: %s %.0f%% %s %.2fW%s [%s]", ent->d_name, capacity, status, watt, drain, name(this->state));
+            break;
+        }
+        closedir(dir);
+#else
+        (void)force;
+#endif
+    }
+};
@@ -0,0 +1,76 @@
+/**
+ * VGS-Zero SDK for Steam - USDT static tracepoints (Linux only)
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * usage:
+ *   sudo bpftrace -l 'usdt:./game:vgs0:*'
+ *   sudo bpftrace -e 'usdt:./game:vgs0:tick_done { @tick = hist(arg1); }'
+ *
+ * probes:
+ *   vgs0:frame_begin(frame)
+ *   vgs0:tick_done(frame, elapsed_us)     ... elapsed_us: since frame_begin
+ *   vgs0:present_done(frame, elapsed_us)
+ *   vgs0:joypad_state(frame, key, pad)
+ *   vgs0:audio_callback(bytes, us)
+ *   vgs0:save_begin(bytes)
+ *   vgs0:save_end(bytes, latency_us, result)
+ *
+ * The arguments are evaluated only while a tracer is attached (checked by the probe semaphore),
+ * and the probe itself is a single nop, so nothing is measurable when nobody is attached.
+ */
+#pragma once
+#include <chrono>
+#include <stdint.h>
+
+#if defined(LINUX) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define PROBE_USDT
+#endif
+#endif
+
+#ifdef PROBE_USDT
+#define PROBE_SEMAPHORE(name) __extension__ unsigned short vgs0_##name##_semaphore __attribute__((unused)) __attribute__((section(".probes")))
+PROBE_SEMAPHORE(frame_begin);
+PROBE_SEMAPHORE(tick_done);
+PROBE_SEMAPHORE(present_done);
+PROBE_SEMAPHORE(joypad_state);
+PROBE_SEMAPHORE(audio_callback);
+PROBE_SEMAPHORE(save_begin);
+PROBE_SEMAPHORE(save_end);
+#define PROBE_ENABLED(name) __builtin_expect(vgs0_##name##_semaphore, 0)
+#define PROBE1(name, a) \
+    do { if (PROBE_ENABLED(name)) STAP_PROBE1(vgs0, name, a); } while (0)
+#define PROBE2(name, a, b) \
+    do { if (PROBE_ENABLED(name)) STAP_PROBE2(vgs0, name, a, b); } while (0)
+#define PROBE3(name, a, b, c) \
+    do { if (PROBE_ENABLED(name)) STAP_PROBE3(vgs0, name, a, b, c); } while (0)
+#else
+#define PROBE_ENABLED(name) 0
+// keep the arguments referenced (never evaluated) to avoid the unused warnings
+#define PROBE1(name, a) \
+    do { if (0) { (void)(a); } } while (0)
+#define PROBE2(name, a, b) \
+    do { if (0) { (void)(a); (void)(b); } } while (0)
+#define PROBE3(name, a, b, c) \
+    do { if (0) { (void)(a); (void)(b); (void)(c); } } while (0)
+#endif
+
+#define PROBE_FRAME_BEGIN(frame) PROBE1(frame_begin, frame)
+#define PROBE_TICK_DONE(frame, us) PROBE2(tick_done, frame, us)
+#define PROBE_PRESENT_DONE(frame, us) PROBE2(present_done, frame, us)
+#define PROBE_JOYPAD_STATE(frame, key, pad) PROBE3(joypad_state, frame, key, pad)
+#define PROBE_AUDIO_CALLBACK(bytes, us) PROBE2(audio_callback, bytes, us)
+#define PROBE_SAVE_BEGIN(bytes) PROBE1(save_begin, bytes)
+#define PROBE_SAVE_END(bytes, us, result) PROBE3(save_end, bytes, us, result)
+
+/**
+ * Microseconds since the specified time point (for the probe arguments and the flight recorder)
+ */
+template <class Clock>
+static inline int64_t probeElapsedUs(const std::chrono::time_point<Clock>& start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
@@ -0,0 +1,458 @@
+/**
+ * VGS-Zero SDK for Steam - Per-frame RAM watch for achievements and leaderboard
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+#pragma once
+#include "picojson.h"
+#include "steam.hpp"
+#include <chrono>
+#include <fstream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define RAM_WATCH_FILE "ramwatch.json"
+#define RAM_WATCH_BUDGET 4096
+#define RAM_WATCH_REPORT_FRAMES 3600
+
+/**
+ * ramwatch.json
+ * {
+ *   "watches": [
+ *     {
+ *       "achievement": "ACH_NO_DAMAGE_BOSS1",
+ *       "when": [
+ *         { "addr": "0xC100", "compare": "==", "value": 0 },
+ *         { "addr": "0xC101", "source": "prev", "compare": "!=", "value": 0 }
+ *       ],
+ *       "reset": [
+ *         { "addr": "0xC200", "source": "delta", "compare": "<", "value": 0 }
+ *       ],
+ *       "hits": 1
+ *     },
+ *     {
+ *       "leaderboard": { "addr": "0xC010", "size": 2 },
+ *       "when": [ { "addr": "0xC000", "compare": "==", "value": 3 } ]
+ *     }
+ *   ]
+ * }
+ *
+ * - addr: Z80 address of the RAM (0xC000 ~ 0xFFFF)
+ * - size: 1 or 2 (little endian, default: 1)
+ * - mask: AND mask applied before compare (default: all bits)
+ * - source: "value" (current frame), "prev" (previous frame) or "delta" (current - previous)
+ * - compare: "==", "!=", "<", "<=", ">", ">=" (default: "!=")
+ * - when: all conditions are true in the frame = 1 hit (the achievement unlocks / the score sends at "hits")
+ * - reset: any condition is true in the frame = clear the hit count
+ *
+ * All operands are read every frame and the watches are executed round robin within RAM_WATCH_BUDGET per frame.
+ * A watch is rejected at the load if the operands + its codes do not fit in the budget (every watch runs in a frame).
+ */
+class RamWatch
+{
+  private:
+    enum class Op : uint8_t {
+        ResetIf, // clear hits and go to the next watch if the condition is true
+        FailIf,  // go to the next watch if the condition is false
+        Hit,     // count a hit and fire at the target hits
+    };
+
+    enum class Source : uint8_t {
+        Value,
+        Prev,
+        Delta,
+    };
+
+    enum class Compare : uint8_t {
+        EQ,
+        NE,
+        LT,
+        LE,
+        GT,
+        GE,
+    };
+
+    struct Code {
+        Op op;
+        Source source;
+        Compare compare;
+        uint8_t reserved;
+        uint16_t operand; // index of operands (Hit: index of watches)
+        uint16_t reserved2;
+        int32_t value;
+    };
+
+    struct Operand {
+        uint16_t offset;
+        uint8_t size;
+        uint8_t reserved;
+        uint32_t mask;
+    };
+
+    struct Watch {
+        uint32_t pc;     // entry point in the codes
+        uint32_t length; // number of the codes (worst case cost)
+        uint32_t hits;   // current hit count
+        uint32_t target;
+        int32_t achievement; // index of ids (-1: leaderboard)
+        int32_t score;       // index of operands (leaderboard)
+        bool fired;
+        bool edge;
+    };
+
+    void (*putlog)(const char*, ...);
+    CSteam* steam;
+    std::vector<Code> codes;
+    std::vector<Operand> operands;
+    std::vector<int32_t> current;
+    std::vector<int32_t> previous;
+    std::vector<Watch> watches;
+    std::vector<std::string> ids;
+    size_t cursor;
+    size_t maxLength; // the longest watch
+    bool primed;
+
+    struct Report {
+        uint64_t frames;
+        uint64_t totalNs;
+        uint64_t maxNs;
+        uint64_t overBudget;
+    } report;
+
+  public:
+    RamWatch(void (*putlog)(const char*, ...), CSteam* steam)
+    {
+        this->putlog = putlog;
+        this->steam = steam;
+        this->cursor = 0;
+        this->maxLength = 0;
+        this->primed = false;
+        memset(&this->report, 0, sizeof(this->report));
+    }
+
+    ~RamWatch()
+    {
+        this->dumpReport();
+    }
+
+    bool load(const char* path = RAM_WATCH_FILE)
+    {
+        std::ifstream ifs(path, std::ios::in);
+        if (ifs.fail()) {
+            return false;
+        }
+        putlog("Loading %s", path);
+        const std::string json((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        ifs.close();
+        picojson::value v;
+        const std::string err = picojson::parse(v, json);
+        if (!err.empty() || !v.is<picojson::object>()) {
+            putlog("Detected error: %s", err.c_str());
+            return false;
+        }
+        auto obj = v.get<picojson::object>();
+        if (!obj["watches"].is<picojson::array>()) {
+            return false;
+        }
+        for (auto& w : obj["watches"].get<picojson::array>()) {
+            if (w.is<picojson::object>()) {
+                this->compile(w.get<picojson::object>());
+            }
+        }
+        this->current.resize(this->operands.size());
+        this->previous.resize(this->operands.size());
+        putlog("- %d watches, %d codes, %d operands", (int)this->watches.size(), (int)this->codes.size(), (int)this->operands.size());
+        if (RAM_WATCH_BUDGET < this->codes.size() + this->operands.size()) {
+            putlog("- the watches are evaluated across frames (budget: %d)", RAM_WATCH_BUDGET);
+        }
+        return true;
+    }
+
+    /**
+     * Forget the history of the previous game (call with every vgs0.reset)
+     * The RAM jumps to the initial values at the reset, so prev/delta and the hit counts would compare against the previous game.
+     * The fired achievements are kept: they are already unlocked.
+     */
+    void reset()
+    {
+        this->primed = false;
+        this->cursor = 0;
+        for (auto& watch : this->watches) {
+            watch.hits = 0;
+            watch.edge = false;
+        }
+    }
+
+    /**
+     * Evaluate the watches after vgs0.tick (ram = vgs0.ctx.ram)
+     * The cost is bounded by RAM_WATCH_BUDGET: reading the operands + executing the codes.
+     * The load guarantees operands + the longest watch <= RAM_WATCH_BUDGET, so the watch at the cursor always runs.
+     */
+    void update(const unsigned char* ram)
+    {
+        if (this->watches.empty()) {
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        int budget = RAM_WATCH_BUDGET;
+        for (size_t i = 0; i < this->operands.size(); i++) {
+            auto& operand = this->operands[i];
+            int32_t v = ram[operand.offset];
+            if (2 == operand.size) {
+                v |= ram[(operand.offset + 1) & 0x3FFF] << 8;
+            }
+            this->previous[i] = this->current[i];
+            this->current[i] = v & operand.mask;
+        }
+        budget -= (int)this->operands.size();
+        if (!this->primed) {
+            // the previous values are not available in the first frame
+            this->primed = true;
+            return;
+        }
+        size_t count = this->watches.size();
+        for (size_t n = 0; n < count; n++) {
+            auto& watch = this->watches[this->cursor];
+            if (!watch.fired) {
+                if (0 < n && budget < (int)watch.length) {
+                    // continue from this watch in the next frame
+                    this->report.overBudget++;
+                    break;
+                }
+                budget -= this->execute(watch);
+            }
+            this->cursor = (this->cursor + 1) % count;
+        }
+        auto ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        this->report.frames++;
+        this->report.totalNs += ns;
+        if (this->report.maxNs < ns) {
+            this->report.maxNs = ns;
+        }
+        if (0 == this->report.frames % RAM_WATCH_REPORT_FRAMES) {
+            this->dumpReport();
+        }
+    }
+
+  private:
+    void dumpReport()
+    {
+        if (0 == this->report.frames) {
+            return;
+        }
+        putlog("RamWatch: %llu frames, avg %.2fus, max %.2fus, over budget %llu frames",
+               (unsigned long long)this->report.frames,
+               this->report.totalNs / 1000.0 / this->report.frames,
+               this->report.maxNs / 1000.0,
+               (unsigned long long)this->report.overBudget);
+    }
+
+    int execute(Watch& watch)
+    {
+        int cost = 0;
+        for (uint32_t pc = watch.pc;; pc++) {
+            auto& code = this->codes[pc];
+            cost++;
+            if (Op::Hit == code.op) {
+                if (watch.edge) {
+                    return cost;
+                }
+                watch.hits++;
+                if (watch.target <= watch.hits) {
+                    watch.hits = 0;
+                    watch.edge = true;
+                    this->fire(watch);
+                }
+                return cost;
+            }
+            int32_t v;
+            switch (code.source) {
+                case Source::Value: v = this->current[code.operand]; break;
+                case Source::Prev: v = this->previous[code.operand]; break;
+                case Source::Delta: v = this->current[code.operand] - this->previous[code.operand]; break;
+                default: v = 0;
+            }
+            bool result;
+            switch (code.compare) {
+                case Compare::EQ: result = v == code.value; break;
+                case Compare::NE: result = v != code.value; break;
+                case Compare::LT: result = v < code.value; break;
+                case Compare::LE: result = v <= code.value; break;
+                case Compare::GT: result = v > code.value; break;
+                case Compare::GE: result = v >= code.value; break;
+                default: result = false;
+            }
+            if (Op::ResetIf == code.op && result) {
+                watch.hits = 0;
+                watch.edge = false;
+                return cost;
+            } else if (Op::FailIf == code.op && !result) {
+                watch.edge = false;
+                return cost;
+            }
+        }
+    }
+
+    void fire(Watch& watch)
+    {
+        if (0 <= watch.achievement) {
+            watch.fired = true;
+            this->steam->unlock(this->ids[watch.achievement].c_str());
+        } else {
+            this->steam->sendScore(this->current[watch.score]);
+        }
+    }
+
+    static int32_t toNumber(picojson::value& v, int32_t defaultValue)
+    {
+        if (v.is<double>()) {
+            return (int32_t)v.get<double>();
+        } else if (v.is<std::string>()) {
+            return (int32_t)strtol(v.get<std::string>().c_str(), nullptr, 0);
+        }
+        return defaultValue;
+    }
+
+    int operand(picojson::object& obj)
+    {
+        int addr = toNumber(obj["addr"], -1);
+        int size = toNumber(obj["size"], 1);
+        if (addr < 0xC000 || 0xFFFF < addr || (1 != size && 2 != size)) {
+            putlog("- invalid addr or size: 0x%X (%d)", addr, size);
+            return -1;
+        }
+        Operand operand;
+        operand.offset = (uint16_t)(addr - 0xC000);
+        operand.size = (uint8_t)size;
+        operand.reserved = 0;
+        operand.mask = (uint32_t)toNumber(obj["mask"], 0xFFFF);
+        for (size_t i = 0; i < this->operands.size(); i++) {
+            auto& o = this->operands[i];
+            if (o.offset == operand.offset && o.size == operand.size && o.mask == operand.mask) {
+                return (int)i;
+            }
+        }
+        this->operands.push_back(operand);
+        return (int)this->operands.size() - 1;
+    }
+
+    bool condition(Op op, picojson::value& v, std::vector<Code>& out)
+    {
+        if (!v.is<picojson::object>()) {
+            return false;
+        }
+        auto obj = v.get<picojson::object>();
+        Code code;
+        memset(&code, 0, sizeof(code));
+        code.op = op;
+        int index = this->operand(obj);
+        if (index < 0) {
+            return false;
+        }
+        code.operand = (uint16_t)index;
+        code.value = toNumber(obj["value"], 0);
+        code.source = Source::Value;
+        if (obj["source"].is<std::string>()) {
+            auto s = obj["source"].get<std::string>();
+            if (s == "prev") {
+                code.source = Source::Prev;
+            } else if (s == "delta") {
+                code.source = Source::Delta;
+            } else if (s != "value") {
+                putlog("- invalid source: %s", s.c_str());
+                return false;
+            }
+        }
+        code.compare = Compare::NE;
+        if (obj["compare"].is<std::string>()) {
+            auto c = obj["compare"].get<std::string>();
+            if (c == "==") {
+                code.compare = Compare::EQ;
+            } else if (c == "!=") {
+                code.compare = Compare::NE;
+            } else if (c == "<") {
+                code.compare = Compare::LT;
+            } else if (c == "<=") {
+                code.compare = Compare::LE;
+            } else if (c == ">") {
+                code.compare = Compare::GT;
+            } else if (c == ">=") {
+                code.compare = Compare::GE;
+            } else {
+                putlog("- invalid compare: %s", c.c_str());
+                return false;
+            }
+        }
+        out.push_back(code);
+        return true;
+    }
+
+    void compile(picojson::object& obj)
+    {
+        // the operands added by a rejected watch are removed (they are read every frame)
+        size_t operandCount = this->operands.size();
+        if (!this->compileWatch(obj)) {
+            this->operands.resize(operandCount);
+        }
+    }
+
+    bool compileWatch(picojson::object& obj)
+    {
+        Watch watch;
+        memset(&watch, 0, sizeof(watch));
+        watch.achievement = -1;
+        watch.score = -1;
+        watch.target = (uint32_t)toNumber(obj["hits"], 1);
+        if (watch.target < 1) {
+            watch.target = 1;
+        }
+        if (obj["achievement"].is<std::string>()) {
+            watch.achievement = (int32_t)this->ids.size();
+        } else if (obj["leaderboard"].is<picojson::object>()) {
+            watch.score = this->operand(obj["leaderboard"].get<picojson::object>());
+            if (watch.score < 0) {
+                return false;
+            }
+        } else {
+            putlog("- skip the watch without achievement or leaderboard");
+            return false;
+        }
+        std::vector<Code> program;
+        if (obj["reset"].is<picojson::array>()) {
+            for (auto& c : obj["reset"].get<picojson::array>()) {
+                if (!this->condition(Op::ResetIf, c, program)) {
+                    return false;
+                }
+            }
+        }
+        if (obj["when"].is<picojson::array>()) {
+            for (auto& c : obj["when"].get<picojson::array>()) {
+                if (!this->condition(Op::FailIf, c, program)) {
+                    return false;
+                }
+            }
+        }
+        Code hit;
+        memset(&hit, 0, sizeof(hit));
+        hit.op = Op::Hit;
+        hit.operand = (uint16_t)this->watches.size();
+        program.push_back(hit);
+        size_t maxLength = this->maxLength < program.size() ? program.size() : this->maxLength;
+        if (RAM_WATCH_BUDGET < this->operands.size() + maxLength) {
+            putlog("- skip the watch exceeding the per-frame budget (%d operands + %d codes > %d)", (int)this->operands.size(), (int)maxLength, RAM_WATCH_BUDGET);
+            return false;
+        }
+        this->maxLength = maxLength;
+        if (0 <= watch.achievement) {
+            this->ids.push_back(obj["achievement"].get<std::string>());
+        }
+        watch.pc = (uint32_t)this->codes.size();
+        watch.length = (uint32_t)program.size();
+        this->codes.insert(this->codes.end(), program.begin(), program.end());
+        this->watches.push_back(watch);
+        return true;
+    }
+};
@@ -0,0 +1,247 @@
+/**
+ * VGS-Zero SDK for Steam - Save data cache and asynchronous writer for Linux and macOS
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+#pragma once
+#include "probe.hpp"
+#include "trace.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <fcntl.h>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define SAVE_FILE_DIR "save"
+#define SAVE_FILE_PATH "save/save.dat"
+#define SAVE_FILE_COALESCE_MS 200
+#define SAVE_FILE_MAX_SIZE 0x4000
+#define SAVE_FILE_RETRY_MS 1000
+#define SAVE_FILE_RETRY_MAX_MS 30000
+#define SAVE_FILE_EXIT_RETRIES 3
+
+class SaveFile
+{
+  private:
+    void (*putlog)(const char*, ...);
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread thread;
+    std::vector<unsigned char> buffer[2]; // buffer[front]: written by the emulator, buffer[front ^ 1]: written to the file
+    int front;
+    bool pending;
+    bool writing;
+    bool end;
+    bool failed; // the last write failed (the data is kept pending and retried)
+    int retries;
+    int exitRetries;
+    int requests;
+    std::chrono::steady_clock::time_point requested;
+    std::vector<unsigned char> cache; // latest save data (coherent with write)
+    bool cached;
+
+  public:
+    void (*onSaved)(int64_t latencyUs); // called from the writer thread (optional)
+
+    SaveFile(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+        this->onSaved = nullptr;
+        this->front = 0;
+        this->pending = false;
+        this->writing = false;
+        this->end = false;
+        this->failed = false;
+        this->retries = 0;
+        this->exitRetries = 0;
+        this->requests = 0;
+        this->cached = false;
+        this->thread = std::thread([this]() { this->main(); });
+    }
+
+    ~SaveFile()
+    {
+        // the writer thread writes the last save data before the exit
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->end = true;
+        }
+        this->cond.notify_all();
+        this->thread.join();
+    }
+
+    /**
+     * Preload the save data into the cache (call once at the startup)
+     */
+    void preload()
+    {
+        unlink(SAVE_FILE_PATH ".tmp"); // remove the incomplete data if the previous write was interrupted
+        FILE* fp = fopen(SAVE_FILE_PATH, "rb");
+        if (!fp) {
+            putlog("save.dat not found");
+            return;
+        }
+        fseek(fp, 0, SEEK_END);
+        long size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (size < 1 || SAVE_FILE_MAX_SIZE < size) {
+            putlog("Invalid save.dat size: %ld (ignored)", size);
+            fclose(fp);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->cache.resize(size);
+        if ((size_t)size != fread(this->cache.data(), 1, size, fp)) {
+            putlog("File read error! (save.dat ignored)");
+            this->cache.clear();
+        } else {
+            this->cached = true;
+            putlog("Preloaded save.dat (%ldbytes)", size);
+        }
+        fclose(fp);
+    }
+
+    /**
+     * Read the save data from the cache (never blocks on the file I/O)
+     */
+    bool read(void* data, size_t size)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        if (!this->cached) {
+            return false;
+        }
+        size_t readSize = this->cache.size() < size ? this->cache.size() : size;
+        memcpy(data, this->cache.data(), readSize);
+        if (readSize < size) {
+            putlog("warning: file size is smaller than expected");
+            memset(&((char*)data)[readSize], 0, size - readSize);
+        }
+        return true;
+    }
+
+    /**
+     * Request to write the save data (never blocks on the file I/O)
+     * Returns false while the previous write is failing (the data is retried until it is written)
+     */
+    bool write(const void* data, size_t size)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        auto ptr = (const unsigned char*)data;
+        this->cache.assign(ptr, ptr + size);
+        this->cached = true;
+        this->buffer[this->front].assign(ptr, ptr + size);
+        if (!this->pending) {
+            this->pending = true;
+            this->requested = std::chrono::steady_clock::now();
+        }
+        this->requests++;
+        this->cond.notify_all();
+        return !this->failed;
+    }
+
+  private:
+    void main()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (true) {
+            this->cond.wait(lock, [this]() { return this->pending || this->end; });
+            if (!this->pending) {
+                return;
+            }
+            // coalesce the repeated saves within the short window
+            this->cond.wait_for(lock, std::chrono::milliseconds(SAVE_FILE_COALESCE_MS), [this]() { return this->end; });
+            auto& data = this->buffer[this->front];
+            this->front ^= 1;
+            this->pending = false;
+            this->writing = true;
+            auto requested = this->requested;
+            int requests = this->requests;
+            this->requests = 0;
+            lock.unlock();
+            TRACE_BEGIN("save write");
+            PROBE_SAVE_BEGIN(data.size());
+            bool result = this->writeFile(data.data(), data.size());
+            TRACE_END("save write");
+            std::chrono::duration<double> latency = std::chrono::steady_clock::now() - requested;
+            PROBE_SAVE_END(data.size(), (int64_t)(latency.count() * 1000000), result ? 1 : 0);
+            if (result) {
+                putlog("Saved save.dat (%dbytes, latency %.1fms, %d request%s)", (int)data.size(), latency.count() * 1000, requests, 1 < requests ? "s" : "");
+                if (this->onSaved) {
+                    this->onSaved((int64_t)(latency.count() * 1000000));
+                }
+            }
+            lock.lock();
+            this->writing = false;
+            this->failed = !result;
+            if (result) {
+                this->retries = 0;
+            } else if (this->end && SAVE_FILE_EXIT_RETRIES <= ++this->exitRetries) {
+                putlog("Cannot write save.dat at the exit (%d retries): the save data is lost", this->exitRetries);
+                this->pending = false;
+            } else {
+                // retry the failed data unless a newer save is requested
+                if (!this->pending) {
+                    this->buffer[this->front].swap(data);
+                    this->pending = true;
+                    this->requested = requested;
+                }
+                this->requests += requests;
+                int delay = SAVE_FILE_RETRY_MS << (this->retries < 5 ? this->retries : 5);
+                delay = delay < SAVE_FILE_RETRY_MAX_MS ? delay : SAVE_FILE_RETRY_MAX_MS;
+                if (!this->end) {
+                    this->retries++;
+                    putlog("Retry to write save.dat in %dms", delay);
+                    this->cond.wait_for(lock, std::chrono::milliseconds(delay), [this]() { return this->end; });
+                }
+            }
+            this->cond.notify_all();
+        }
+    }
+
+    bool writeFile(const void* data, size_t size)
+    {
+        // write to temp -> fsync -> rename: the save.dat is always the old or new complete data
+        const char* tmp = SAVE_FILE_PATH ".tmp";
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            putlog("File open error! (%s)", tmp);
+            return false;
+        }
+        auto ptr = (const unsigned char*)data;
+        size_t left = size;
+        while (0 < left) {
+            auto written = ::write(fd, ptr, left);
+            if (written < 0) {
+                putlog("File write error!");
+                close(fd);
+                unlink(tmp);
+                return false;
+            }
+            ptr += written;
+            left -= written;
+        }
+        if (0 != fsync(fd)) {
+            putlog("fsync error!");
+            close(fd);
+            unlink(tmp);
+            return false;
+        }
+        close(fd);
+        if (0 != rename(tmp, SAVE_FILE_PATH)) {
+            putlog("File rename error!");
+            unlink(tmp);
+            return false;
+        }
+        int dir = open(SAVE_FILE_DIR, O_RDONLY);
+        if (0 <= dir) {
+            fsync(dir);
+            close(dir);
+        }
+        return true;
+    }
+};
@@ -0,0 +1,271 @@
+/**
+ * VGS-Zero SDK for Steam - Declarative achievement rules for the save data
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+#pragma once
+#include "picojson.h"
+#include "steam.hpp"
+#include <fstream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define SAVE_RULES_FILE "achievement.json"
+#define SAVE_RULES_BLOCK_SIZE 64
+#define SAVE_RULES_MAX_SIZE 0x4000
+
+/**
+ * achievement.json
+ * {
+ *   "achievements": [
+ *     { "id": "ACH_STAGE1", "offset": "0x0010", "size": 1, "mask": "0x01", "compare": "!=", "value": 0 }
+ *   ],
+ *   "leaderboard": { "offset": "0x0020", "size": 4, "endian": "little" }
+ * }
+ *
+ * - offset: byte offset in the save data (number or "0x" string)
+ * - size: 1, 2 or 4 (default: 1)
+ * - endian: "little" or "big" (default: little)
+ * - mask: AND mask applied before compare (default: all bits)
+ * - compare: "==", "!=", "<", "<=", ">", ">=" (default: "!=")
+ * - value: compare value (default: 0)
+ */
+class SaveRules
+{
+  private:
+    enum class Compare : uint8_t {
+        EQ,
+        NE,
+        LT,
+        LE,
+        GT,
+        GE,
+    };
+
+    struct Rule {
+        uint16_t offset;
+        uint8_t size;
+        uint8_t bigEndian;
+        Compare compare;
+        uint32_t mask;
+        uint32_t value;
+        int32_t achievement; // index of ids (-1: leaderboard)
+        uint32_t stamp;
+    };
+
+    void (*putlog)(const char*, ...);
+    CSteam* steam;
+    std::vector<Rule> rules;
+    std::vector<std::string> ids;
+    std::vector<uint16_t> blockStart; // rules touching the block N: blockRules[blockStart[N] .. blockStart[N + 1]]
+    std::vector<uint16_t> blockRules;
+    std::vector<unsigned char> previous;
+    uint32_t stamp;
+    uint32_t lastScore;
+
+  public:
+    SaveRules(void (*putlog)(const char*, ...), CSteam* steam)
+    {
+        this->putlog = putlog;
+        this->steam = steam;
+        this->stamp = 0;
+        this->lastScore = 0;
+    }
+
+    bool load(const char* path = SAVE_RULES_FILE)
+    {
+        std::ifstream ifs(path, std::ios::in);
+        if (ifs.fail()) {
+            return false;
+        }
+        putlog("Loading %s", path);
+        const std::string json((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        ifs.close();
+        picojson::value v;
+        const std::string err = picojson::parse(v, json);
+        if (!err.empty() || !v.is<picojson::object>()) {
+            putlog("Detected error: %s", err.c_str());
+            return false;
+        }
+        auto obj = v.get<picojson::object>();
+        if (obj["achievements"].is<picojson::array>()) {
+            for (auto& a : obj["achievements"].get<picojson::array>()) {
+                if (!a.is<picojson::object>()) continue;
+                auto ach = a.get<picojson::object>();
+                if (!ach["id"].is<std::string>()) {
+                    putlog("- skip the rule without id");
+                    continue;
+                }
+                Rule rule;
+                if (this->parse(ach, &rule)) {
+                    rule.achievement = (int32_t)this->ids.size();
+                    this->ids.push_back(ach["id"].get<std::string>());
+                    this->rules.push_back(rule);
+                }
+            }
+        }
+        if (obj["leaderboard"].is<picojson::object>()) {
+            auto lb = obj["leaderboard"].get<picojson::object>();
+            Rule rule;
+            if (this->parse(lb, &rule)) {
+                rule.achievement = -1;
+                this->rules.push_back(rule);
+            }
+        }
+        this->compile();
+        putlog("- %d rules (%d achievements)", (int)this->rules.size(), (int)this->ids.size());
+        return true;
+    }
+
+    /**
+     * Check the save data.
+     * The first call evaluates all rules (synchronize the achievements with the existing save data),
+     * and the following calls evaluate only the rules that touch the changed blocks.
+     */
+    void check(const void* data, size_t size)
+    {
+        if (this->rules.empty()) {
+            return;
+        }
+        auto ptr = (const unsigned char*)data;
+        if (SAVE_RULES_MAX_SIZE < size) {
+            size = SAVE_RULES_MAX_SIZE;
+        }
+        if (this->previous.size() != size) {
+            for (auto& rule : this->rules) {
+                this->evaluate(rule, ptr, size);
+            }
+            this->previous.assign(ptr, ptr + size);
+            return;
+        }
+        this->stamp++;
+        auto prev = this->previous.data();
+        size_t blocks = this->blockStart.size() - 1;
+        for (size_t b = 0; b < blocks; b++) {
+            size_t offset = b * SAVE_RULES_BLOCK_SIZE;
+            if (size <= offset) {
+                break;
+            }
+            size_t len = size - offset < SAVE_RULES_BLOCK_SIZE ? size - offset : SAVE_RULES_BLOCK_SIZE;
+            if (0 == memcmp(&prev[offset], &ptr[offset], len)) {
+                continue;
+            }
+            for (int i = this->blockStart[b]; i < this->blockStart[b + 1]; i++) {
+                auto& rule = this->rules[this->blockRules[i]];
+                if (rule.stamp != this->stamp) {
+                    rule.stamp = this->stamp;
+                    this->evaluate(rule, ptr, size);
+                }
+            }
+            memcpy(&prev[offset], &ptr[offset], len);
+        }
+    }
+
+  private:
+    static uint32_t toNumber(picojson::value& v, uint32_t defaultValue)
+    {
+        if (v.is<double>()) {
+            return (uint32_t)(int64_t)v.get<double>();
+        } else if (v.is<std::string>()) {
+            return (uint32_t)strtoul(v.get<std::string>().c_str(), nullptr, 0);
+        }
+        return defaultValue;
+    }
+
+    bool parse(picojson::object& obj, Rule* rule)
+    {
+        uint32_t offset = toNumber(obj["offset"], 0);
+        uint32_t size = toNumber(obj["size"], 1);
+        if (1 != size && 2 != size && 4 != size) {
+            putlog("- invalid size: %u", size);
+            return false;
+        }
+        if (SAVE_RULES_MAX_SIZE <= offset || SAVE_RULES_MAX_SIZE - offset < size) {
+            putlog("- invalid offset: 0x%X", offset);
+            return false;
+        }
+        rule->offset = (uint16_t)offset;
+        rule->size = (uint8_t)size;
+        rule->bigEndian = obj["endian"].is<std::string>() && obj["endian"].get<std::string>() == "big";
+        rule->mask = toNumber(obj["mask"], 0xFFFFFFFF);
+        rule->value = toNumber(obj["value"], 0);
+        rule->compare = Compare::NE;
+        rule->stamp = 0;
+        if (obj["compare"].is<std::string>()) {
+            auto c = obj["compare"].get<std::string>();
+            if (c == "==") {
+                rule->compare = Compare::EQ;
+            } else if (c == "!=") {
+                rule->compare = Compare::NE;
+            } else if (c == "<") {
+                rule->compare = Compare::LT;
+            } else if (c == "<=") {
+                rule->compare = Compare::LE;
+            } else if (c == ">") {
+                rule->compare = Compare::GT;
+            } else if (c == ">=") {
+                rule->compare = Compare::GE;
+            } else {
+                putlog("- invalid compare: %s", c.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void compile()
+    {
+        int blocks = SAVE_RULES_MAX_SIZE / SAVE_RULES_BLOCK_SIZE;
+        std::vector<std::vector<uint16_t>> index(blocks);
+        for (size_t i = 0; i < this->rules.size(); i++) {
+            auto& rule = this->rules[i];
+            int first = rule.offset / SAVE_RULES_BLOCK_SIZE;
+            int last = (rule.offset + rule.size - 1) / SAVE_RULES_BLOCK_SIZE;
+            for (int b = first; b <= last; b++) {
+                index[b].push_back((uint16_t)i);
+            }
+        }
+        this->blockStart.clear();
+        this->blockRules.clear();
+        for (auto& list : index) {
+            this->blockStart.push_back((uint16_t)this->blockRules.size());
+            this->blockRules.insert(this->blockRules.end(), list.begin(), list.end());
+        }
+        this->blockStart.push_back((uint16_t)this->blockRules.size());
+    }
+
+    void evaluate(const Rule& rule, const unsigned char* data, size_t size)
+    {
+        if (size < (size_t)rule.offset + rule.size) {
+            return;
+        }
+        const unsigned char* ptr = &data[rule.offset];
+        uint32_t v = 0;
+        for (int i = 0; i < rule.size; i++) {
+            v |= (uint32_t)ptr[rule.bigEndian ? i : rule.size - 1 - i] << ((rule.size - 1 - i) * 8);
+        }
+        v &= rule.mask;
+        bool result;
+        switch (rule.compare) {
+            case Compare::EQ: result = v == rule.value; break;
+            case Compare::NE: result = v != rule.value; break;
+            case Compare::LT: result = v < rule.value; break;
+            case Compare::LE: result = v <= rule.value; break;
+            case Compare::GT: result = v > rule.value; break;
+            case Compare::GE: result = v >= rule.value; break;
+            default: result = false;
+        }
+        if (!result) {
+            return;
+        }
+        if (0 <= rule.achievement) {
+            this->steam->unlock(this->ids[rule.achievement].c_str());
+        } else if (v != this->lastScore) {
+            this->lastScore = v;
+            this->steam->sendScore((int)v);
+        }
+    }
+};
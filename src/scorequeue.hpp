@@ -0,0 +1,243 @@
+/**
+ * VGS-Zero SDK for Steam - Leaderboard upload queue (best score coalescing, rate limit and persistence)
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * Rate limit: token bucket of SCORE_QUEUE_BURST tokens refilled 1 per SCORE_QUEUE_INTERVAL seconds,
+ * so any 600 seconds window has BURST + 600 / INTERVAL = 10 uploads at most (Steam blocks more than 10 per 10 minutes).
+ * The pending score and the tokens are persisted by the writer thread (the caller never waits for the file I/O),
+ * so a restart does not refill the bucket: the tokens are restored with the refill of the wall clock time since the save.
+ * File: line 1 leaderboard name, line 2 pending score ("-": none), line 3 tokens and the unix time of the tokens
+ */
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+
+#define SCORE_QUEUE_FILE "leaderboard.dat"
+#define SCORE_QUEUE_BURST 5
+#define SCORE_QUEUE_INTERVAL 120
+
+class ScoreQueue
+{
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+  private:
+    void (*putlog)(const char*, ...);
+    std::string path;
+    std::string name;
+    bool pending;
+    int pendingScore;
+    bool uploading;
+    int uploadingScore;
+    double tokens;
+    Clock::time_point tokenTime;
+    bool tokenStarted;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread thread;
+    bool end;
+    bool dirty;
+    bool fileValid; // snapshot of the file contents (written by the writer thread)
+    int fileScore;
+    double fileTokens;
+    int64_t fileTokenTime; // unix time (0: the bucket has never been used)
+
+  public:
+    ScoreQueue(void (*putlog)(const char*, ...), const char* path = SCORE_QUEUE_FILE)
+    {
+        this->putlog = putlog;
+        this->path = path;
+        this->pending = false;
+        this->pendingScore = 0;
+        this->uploading = false;
+        this->uploadingScore = 0;
+        this->tokens = SCORE_QUEUE_BURST;
+        this->tokenStarted = false;
+        this->end = false;
+        this->dirty = false;
+        this->fileValid = false;
+        this->fileScore = 0;
+        this->fileTokens = SCORE_QUEUE_BURST;
+        this->fileTokenTime = 0;
+    }
+
+    ~ScoreQueue()
+    {
+        // the writer thread writes the last pending score before the exit
+        if (this->thread.joinable()) {
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->end = true;
+            }
+            this->cond.notify_all();
+            this->thread.join();
+        }
+    }
+
+    /**
+     * Load the pending score of the leaderboard and start the writer thread
+     */
+    void start(const char* name)
+    {
+        this->name = name;
+        this->load();
+        this->thread = std::thread([this]() { this->main(); });
+    }
+
+    inline bool isStarted() { return this->thread.joinable(); }
+
+    /**
+     * Queue the score (only the best score is kept until the upload: the upload method is KeepBest)
+     */
+    void push(int score)
+    {
+        if (this->pending && score <= this->pendingScore) {
+            return;
+        }
+        this->pendingScore = score;
+        this->pending = true;
+        this->save();
+    }
+
+    /**
+     * Take the score to upload if a token is available (false: nothing to upload now)
+     */
+    bool pop(Clock::time_point now, int* score)
+    {
+        if (!this->pending || this->uploading) {
+            return false;
+        }
+        if (!this->tokenStarted) {
+            this->tokenStarted = true;
+            this->tokenTime = now;
+        }
+        std::chrono::duration<double> elapsed = now - this->tokenTime;
+        this->tokenTime = now;
+        this->tokens += elapsed.count() / SCORE_QUEUE_INTERVAL;
+        if (SCORE_QUEUE_BURST < this->tokens) {
+            this->tokens = SCORE_QUEUE_BURST;
+        }
+        if (this->tokens < 1.0) {
+            return false;
+        }
+        this->tokens -= 1.0;
+        this->uploadingScore = this->pendingScore;
+        this->uploading = true;
+        this->pending = false;
+        *score = this->uploadingScore;
+        this->save(toUnixTime(now));
+        return true;
+    }
+
+    /**
+     * Result of the upload taken by pop (the failed score is queued again)
+     */
+    void uploaded(bool succeeded)
+    {
+        this->uploading = false;
+        if (!succeeded && (!this->pending || this->pendingScore < this->uploadingScore)) {
+            this->pendingScore = this->uploadingScore;
+            this->pending = true;
+        }
+        this->save();
+    }
+
+  private:
+    static int64_t toUnixTime(Clock::time_point time)
+    {
+        auto wall = std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(time - Clock::now());
+        return (int64_t)std::chrono::duration_cast<std::chrono::seconds>(wall.time_since_epoch()).count();
+    }
+
+    void load()
+    {
+        // line 1: leaderboard name (may contain spaces), line 2: score, line 3: tokens
+        FILE* fp = fopen(this->path.c_str(), "rt");
+        if (!fp) {
+            return;
+        }
+        char name[256];
+        char score[32];
+        char tokens[64];
+        if (fgets(name, sizeof(name), fp) && fgets(score, sizeof(score), fp)) {
+            name[strcspn(name, "\r\n")] = 0;
+            if (this->name == name && '-' != score[0]) {
+                this->pendingScore = atoi(score);
+                this->pending = true;
+                this->fileValid = true;
+                this->fileScore = this->pendingScore;
+                putlog("Pending score found: %d", this->pendingScore);
+            }
+            double saved;
+            long long time;
+            if (fgets(tokens, sizeof(tokens), fp) && 2 == sscanf(tokens, "%lf %lld", &saved, &time)) {
+                // the tokens are used by any leaderboard of the user (the clock moved back: no refill)
+                double elapsed = (double)(toUnixTime(Clock::now()) - time);
+                this->tokens = saved + (0 < elapsed ? elapsed / SCORE_QUEUE_INTERVAL : 0);
+                this->tokens = this->tokens < 0 ? 0 : (SCORE_QUEUE_BURST < this->tokens ? SCORE_QUEUE_BURST : this->tokens);
+                this->fileTokens = saved;
+                this->fileTokenTime = time;
+                putlog("Leaderboard upload tokens: %.2f", this->tokens);
+            }
+        }
+        fclose(fp);
+    }
+
+    void save(int64_t tokenTime = 0)
+    {
+        bool valid = this->pending || this->uploading;
+        int score = this->pending ? this->pendingScore : this->uploadingScore;
+        if (this->pending && this->uploading && score < this->uploadingScore) {
+            score = this->uploadingScore;
+        }
+        std::unique_lock<std::mutex> lock(this->mutex);
+        if (tokenTime) {
+            this->fileTokens = this->tokens;
+            this->fileTokenTime = tokenTime;
+        } else if (valid == this->fileValid && (!valid || score == this->fileScore)) {
+            return;
+        }
+        this->fileValid = valid;
+        this->fileScore = score;
+        this->dirty = true;
+        this->cond.notify_all();
+    }
+
+    void main()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (true) {
+            this->cond.wait(lock, [this]() { return this->dirty || this->end; });
+            if (!this->dirty) {
+                return;
+            }
+            this->dirty = false;
+            bool valid = this->fileValid;
+            int score = this->fileScore;
+            double tokens = this->fileTokens;
+            int64_t tokenTime = this->fileTokenTime;
+            lock.unlock();
+            FILE* fp = fopen(this->path.c_str(), "wt");
+            if (!fp) {
+                putlog("Cannot save the pending score!");
+            } else {
+                if (valid) {
+                    fprintf(fp, "%s\n%d\n", this->name.c_str(), score);
+                } else {
+                    fprintf(fp, "%s\n-\n", this->name.c_str());
+                }
+                fprintf(fp, "%.4f %lld\n", tokens, (long long)tokenTime);
+                fclose(fp);
+            }
+            lock.lock();
+        }
+    }
+};
@@ -20,6 +20,7 @@ public:
         int windowHeight;
         bool isFullScreen;
         bool isScanline;
+        int maxFrameSkip; // 0: disabled
     } graphic;
 
     struct Sound {
@@ -40,12 +41,27 @@ public:
         int quit;
     } keyboard;
 
+    struct Automation {
+        bool metrics;
+        std::string metricsSocket;
+        bool control;
+        std::string controlSocket;
+        std::string sharedMemory;
+    } automation;
+
+    struct Power {
+        bool sleepUnfocused;    // stop the emulation while the window is not focused
+        bool pauseAudio;        // pause the audio device while sleeping (false: keep the sound)
+        int batteryLogInterval; // seconds (0: only at the state transitions)
+    } power;
+
     Config()
     {
         graphic.windowWidth = 480;
         graphic.windowHeight = 384;
         graphic.isFullScreen = true;
         graphic.isScanline = true;
+        graphic.maxFrameSkip = 3;
         sound.volumeBgm = 100;
         sound.volumeSe = 100;
         keyboard.up = SDLK_UP;
@@ -58,6 +74,14 @@ public:
         keyboard.a = SDLK_x;
         keyboard.reset = SDLK_r;
         keyboard.quit = SDLK_q;
+        automation.metrics = false;
+        automation.metricsSocket = "metrics.sock";
+        automation.control = false;
+        automation.controlSocket = "control.sock";
+        automation.sharedMemory = "";
+        power.sleepUnfocused = false;
+        power.pauseAudio = true;
+        power.batteryLogInterval = 60;
         load();
         dump();
     }
@@ -68,6 +92,7 @@ public:
         log("- graphic.windowHeight: %d", graphic.windowHeight);
         log("- graphic.isFullScreen: %s", graphic.isFullScreen ? "true" : "false");
         log("- graphic.isScanline: %s", graphic.isScanline ? "true" : "false");
+        log("- graphic.maxFrameSkip: %d", graphic.maxFrameSkip);
         log("- sound.volumeBgm: %d", sound.volumeBgm);
         log("- sound.volumeSe: %d", sound.volumeSe);
         log("- keyboard.up: 0x%X", keyboard.up);
@@ -80,6 +105,14 @@ public:
         log("- keyboard.select: 0x%X", keyboard.select);
         log("- keyboard.reset: 0x%X", keyboard.reset);
         log("- keyboard.quit: 0x%X", keyboard.quit);
+        log("- automation.metrics: %s", automation.metrics ? "true" : "false");
+        log("- automation.metricsSocket: %s", automation.metricsSocket.c_str());
+        log("- automation.control: %s", automation.control ? "true" : "false");
+        log("- automation.controlSocket: %s", automation.controlSocket.c_str());
+        log("- automation.sharedMemory: %s", automation.sharedMemory.c_str());
+        log("- power.sleepUnfocused: %s", power.sleepUnfocused ? "true" : "false");
+        log("- power.pauseAudio: %s", power.pauseAudio ? "true" : "false");
+        log("- power.batteryLogInterval: %d", power.batteryLogInterval);
     }
 
     void save()
@@ -90,11 +123,14 @@ public:
         picojson::object graphicJson;
         picojson::object soundJson;
         picojson::object keyboardJson;
+        picojson::object automationJson;
+        picojson::object powerJson;
 
         graphicJson.insert(std::make_pair("windowWidth", picojson::value((double)graphic.windowWidth)));
         graphicJson.insert(std::make_pair("windowHeight", picojson::value((double)graphic.windowHeight)));
         graphicJson.insert(std::make_pair("isFullScreen", picojson::value(graphic.isFullScreen)));
         graphicJson.insert(std::make_pair("isScanline", picojson::value(graphic.isScanline)));
+        graphicJson.insert(std::make_pair("maxFrameSkip", picojson::value((double)graphic.maxFrameSkip)));
         o.insert(std::make_pair("graphic", graphicJson));
 
         soundJson.insert(std::make_pair("volumeBgm", picojson::value((double)sound.volumeBgm)));
@@ -113,6 +149,18 @@ public:
         keyboardJson.insert(std::make_pair("quit", picojson::value(toString(keyboard.quit))));
         o.insert(std::make_pair("keyboard", keyboardJson));
 
+        automationJson.insert(std::make_pair("metrics", picojson::value(automation.metrics)));
+        automationJson.insert(std::make_pair("metricsSocket", picojson::value(automation.metricsSocket)));
+        automationJson.insert(std::make_pair("control", picojson::value(automation.control)));
+        automationJson.insert(std::make_pair("controlSocket", picojson::value(automation.controlSocket)));
+        automationJson.insert(std::make_pair("sharedMemory", picojson::value(automation.sharedMemory)));
+        o.insert(std::make_pair("automation", automationJson));
+
+        powerJson.insert(std::make_pair("sleepUnfocused", picojson::value(power.sleepUnfocused)));
+        powerJson.insert(std::make_pair("pauseAudio", picojson::value(power.pauseAudio)));
+        powerJson.insert(std::make_pair("batteryLogInterval", picojson::value((double)power.batteryLogInterval)));
+        o.insert(std::make_pair("power", powerJson));
+
         try {
             std::ofstream ofs("config.json");
             ofs << picojson::value(o).serialize(true) << std::endl;
@@ -211,6 +259,13 @@ public:
             graphic.isScanline = graphicJson["isScanline"].get<bool>();
         }
 
+        if (graphicJson["maxFrameSkip"].is<double>()) {
+            graphic.maxFrameSkip = (int)graphicJson["maxFrameSkip"].get<double>();
+            if (graphic.maxFrameSkip < 0) {
+                graphic.maxFrameSkip = 0;
+            }
+        }
+
         auto soundJson = obj["sound"].get<picojson::object>();
         if (soundJson.find("volumeBgm")->second.is<double>()) {
             sound.volumeBgm = (int)soundJson["volumeBgm"].get<double>();
@@ -290,5 +345,38 @@ public:
         } else if (keyboardJson.find("quit")->second.is<std::string>()) {
             keyboard.quit = toKeyCode(keyboardJson["quit"].get<std::string>().c_str());
         }
+
+        // optional (not exist in the config.json of the older version)
+        if (obj["automation"].is<picojson::object>()) {
+            auto automationJson = obj["automation"].get<picojson::object>();
+            if (automationJson["metrics"].is<bool>()) {
+                automation.metrics = automationJson["metrics"].get<bool>();
+            }
+            if (automationJson["metricsSocket"].is<std::string>()) {
+                automation.metricsSocket = automationJson["metricsSocket"].get<std::string>();
+            }
+            if (automationJson["control"].is<bool>()) {
+                automation.control = automationJson["control"].get<bool>();
+            }
+            if (automationJson["controlSocket"].is<std::string>()) {
+                automation.controlSocket = automationJson["controlSocket"].get<std::string>();
+            }
+            if (automationJson["sharedMemory"].is<std::string>()) {
+                automation.sharedMemory = automationJson["sharedMemory"].get<std::string>();
+            }
+        }
+
+        if (obj["power"].is<picojson::object>()) {
+            auto powerJson = obj["power"].get<picojson::object>();
+            if (powerJson["sleepUnfocused"].is<bool>()) {
+                power.sleepUnfocused = powerJson["sleepUnfocused"].get<bool>();
+            }
+            if (powerJson["pauseAudio"].is<bool>()) {
+                power.pauseAudio = powerJson["pauseAudio"].get<bool>();
+            }
+            if (powerJson["batteryLogInterval"].is<double>()) {
+                power.batteryLogInterval = (int)powerJson["batteryLogInterval"].get<double>();
+            }
+        }
     }
 };
@@ -6,15 +6,34 @@
 #include "SDL.h"
 #include "gamepkg.h"
 #include "../vgszero/src/core/vgs0.hpp"
+#include "automation.hpp"
 #include "steam.hpp"
+#include "trace.hpp"
+#include "flightrec.hpp"
+#include "frameskip.hpp"
+#include "image.hpp"
+#include "logger.hpp"
+#include "memstats.hpp"
+#include "metrics.hpp"
+#include "package.hpp"
+#include "perfcounter.hpp"
+#include "pkgfile.hpp"
+#include "powerstate.hpp"
+#include "probe.hpp"
+#include "ramwatch.hpp"
+#include "savefile.hpp"
+#include "saverules.hpp"
 #include "sdlconf.hpp"
+#include "startup.hpp"
 #include <chrono>
 #include <map>
+#include <optional>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 #include <sys/stat.h>
@@ -24,48 +43,105 @@
 #else
 #define WINDOW_TITLE "Battle Marine for Linux"
 #endif
+#define JOYPAD_WAIT_MS 100 // wake-up interval while waiting for the joypad
 
 extern "C" {
-    extern const unsigned int img_err_joypad[17664];
+    extern const unsigned char img_atlas[];
+    extern const int img_atlas_size;
 };
 
 static pthread_mutex_t soundMutex = PTHREAD_MUTEX_INITIALIZER;
 static bool halt = false;
 static CSteam* steam = nullptr;
+static SaveRules* saveRules = nullptr;
+static RamWatch* ramWatch = nullptr;
+static SaveFile* saveFile = nullptr;
+static FlightRecorder* flightRecorder = nullptr;
+static Metrics* metrics = nullptr;
+static Automation* automation = nullptr;
+static int audioBytesPerSecond = 44100 * 2; // updated with the obtained audio spec before the playback
+
+static Logger* logger = nullptr;
 
 void log(const char* format, ...)
 {
-    FILE* fp = fopen("log.txt", "a");
-    if (!fp) return;
-    char buf[256];
-    auto now = time(nullptr);
-    auto t = localtime(&now);
+    if (!logger) return;
+    va_list args;
+    va_start(args, format);
+    logger->vprint(Logger::Level::Info, format, args);
+    va_end(args);
+}
+
+static void logError(const char* format, ...)
+{
+    if (!logger) return;
     va_list args;
     va_start(args, format);
-    vsnprintf(buf, sizeof(buf), format, args);
+    logger->vprint(Logger::Level::Error, format, args);
     va_end(args);
-    fprintf(fp, "%04d.%02d.%02d %02d:%02d:%02d %s\n",
-           t->tm_year + 1900,
-           t->tm_mon + 1,
-           t->tm_mday,
-           t->tm_hour,
-           t->tm_min,
-           t->tm_sec,
-           buf);
-    fclose(fp);
 }
 
 static void audioCallback(void* userdata, Uint8* stream, int len)
 {
+    TRACE_SCOPE("audioCallback");
+    auto probeStart = PROBE_ENABLED(audio_callback) ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
     VGS0* vgs0 = (VGS0*)userdata;
     pthread_mutex_lock(&soundMutex);
     if (halt) {
         pthread_mutex_unlock(&soundMutex);
         return;
     }
-    void* buf = vgs0->tickSound(len);
-    memcpy(stream, buf, len);
+    bool paused = automation && !automation->tickable();
+    if (paused) {
+        memset(stream, 0, len); // the sound is not advanced while the automation pauses the emulator
+    } else {
+        void* buf = vgs0->tickSound(len);
+        memcpy(stream, buf, len);
+    }
     pthread_mutex_unlock(&soundMutex);
+    flightRecorder->audio(len);
+    if (metrics) {
+        metrics->audio(len, audioBytesPerSecond);
+    }
+    if (automation && !paused) {
+        automation->audio(stream, len);
+    }
+    PROBE_AUDIO_CALLBACK(len, probeElapsedUs(probeStart));
+}
+
+static void loadPackage(VGS0* vgs0, Package* package)
+{
+    if (0 < package->getSize(Package::Bgm)) {
+        vgs0->loadBgm(package->get(Package::Bgm), package->getSize(Package::Bgm));
+    }
+    if (0 < package->getSize(Package::Se)) {
+        vgs0->loadSoundEffect(package->get(Package::Se), package->getSize(Package::Se));
+    }
+    vgs0->loadRom(package->get(Package::Rom), package->getSize(Package::Rom));
+}
+
+// the overlay image is uploaded once and composited by the renderer
+static SDL_Texture* createOverlayTexture(SDL_Renderer* renderer, ImageAtlas* images, const char* name, SDL_Rect* rect)
+{
+    int index = images->find(name);
+    if (index < 0) {
+        logError("Image not found: %s", name);
+        return nullptr;
+    }
+    int w = images->getWidth(index);
+    int h = images->getHeight(index);
+    std::vector<uint32_t> pixels(w * h, 0);
+    images->draw(index, pixels.data(), w, w, h, 0, 0);
+    auto result = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, w, h);
+    if (!result) {
+        logError("SDL_CreateTexture failed: %s", SDL_GetError());
+        return nullptr;
+    }
+    SDL_UpdateTexture(result, nullptr, pixels.data(), w * 4);
+    SDL_SetTextureBlendMode(result, SDL_BLENDMODE_BLEND);
+    rect->w = w;
+    rect->h = h;
+    return result;
 }
 
 static inline unsigned char bit5To8(unsigned char bit5)
@@ -77,9 +153,19 @@ static inline unsigned char bit5To8(unsigned char bit5)
 
 int main(int argc, char* argv[])
 {
+    StartupTimeline timeline(log);
     unlink("log.txt");
+    logger = new Logger();
+    atexit([]() {
+        // not deleted: the threads that are still running (e.g. at exit(-1)) may call log
+        logger->shutdown();
+    });
     bool cliError = false;
     int gpuType = SDL_WINDOW_OPENGL;
+    const char* tracePath = nullptr;
+    bool perfMode = false;
+    bool memStatsMode = false;
+    const char* packagePath = nullptr;
 
     for (int i = 1; !cliError && i < argc; i++) {
         switch (tolower(argv[i][1])) {
@@ -101,6 +187,35 @@ int main(int argc, char* argv[])
                     gpuType = 0;
                 }
                 break;
+            case 't':
+                i++;
+                if (argc <= i) {
+                    cliError = true;
+                    break;
+                }
+                tracePath = argv[i];
+                break;
+            case 'p':
+                if (0 == strcasecmp(argv[i], "-perf")) {
+                    perfMode = true;
+                } else if (0 == strcasecmp(argv[i], "-p")) {
+                    i++;
+                    if (argc <= i) {
+                        cliError = true;
+                        break;
+                    }
+                    packagePath = argv[i];
+                } else {
+                    cliError = true;
+                }
+                break;
+            case 'm':
+                if (0 == strcasecmp(argv[i], "-memstats")) {
+                    memStatsMode = true;
+                } else {
+                    cliError = true;
+                }
+                break;
             case 'h':
                 cliError = true;
                 break;
@@ -121,30 +236,106 @@ int main(int argc, char* argv[])
         puts("                   | Metal ............. GPU: Metal");
 #endif
         puts("                   }]");
+        puts("               [-trace /path/to/trace.json ..... Record the Chrome Trace Event]");
+#ifdef LINUX
+        puts("               [-perf .......................... Report the hardware counters to log.txt]");
+#endif
+        puts("               [-p /path/to/game.pkg ........... Run the external package (reloaded when updated)]");
+        puts("               [-memstats ...................... Report the memory usage and audit the main loop allocations]");
         return 1;
     }
+    if (tracePath) {
+        if (!Trace::start(tracePath)) {
+            printf("Cannot open %s\n", tracePath);
+            return 1;
+        }
+        Trace::setThreadName("main");
+    }
 
     log("Booting %s", WINDOW_TITLE);
+    MemStats memStats(log);
+    if (memStatsMode) {
+        memStats.start();
+    }
     SDL_version sdlVersion;
     SDL_GetVersion(&sdlVersion);
     log("SDL version: %d.%d.%d", sdlVersion.major, sdlVersion.minor, sdlVersion.patch);
-    Config cfg;
 
+    // config, package and save preload run on the worker threads while Steam and SDL initialize on the main thread
     steam = new CSteam(log);
-    steam->init();
+    saveRules = new SaveRules(log, steam);
+    ramWatch = new RamWatch(log, steam);
 
-    log("Initializing SDL");
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS)) {
-        log("SDL_Init failed: %s", SDL_GetError());
+    std::optional<Config> config;
+    std::thread configThread([&timeline, &config]() {
+        {
+            StartupTimeline::Scope scope(&timeline, "config");
+            config.emplace();
+        }
+        StartupTimeline::Scope scope(&timeline, "rules");
+        saveRules->load();
+        ramWatch->load();
+    });
+
+    VGS0 vgs0;
+    auto package = new Package(log);
+    PackageFile* packageFile = packagePath ? new PackageFile(log) : nullptr;
+    bool packageError = false;
+    std::thread packageThread([&timeline, &vgs0, package, packageFile, packagePath, &packageError]() {
+        StartupTimeline::Scope scope(&timeline, "package");
+        log("Initializing VGS-Zero");
+        if (packageFile) {
+            packageError = !packageFile->open(packagePath) || !package->open(packageFile->getData(), packageFile->getSize());
+        } else {
+            packageError = !package->open(gamepkg, gamepkg_layout); // the layout is checked at build time (see gamepkg.h)
+        }
+        if (!packageError) {
+            loadPackage(&vgs0, package);
+        }
+    });
+
+    std::thread saveThread([&timeline]() {
+        StartupTimeline::Scope scope(&timeline, "save preload");
+        mkdir("save",  S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IWGRP | S_IXGRP | S_IROTH | S_IXOTH | S_IXOTH);
+        saveFile = new SaveFile(log);
+        saveFile->preload();
+    });
+
+    // the workers must be finished before the exit handlers run
+    auto exitStartup = [&configThread, &packageThread, &saveThread]() {
+        for (auto thread : {&configThread, &packageThread, &saveThread}) {
+            if (thread->joinable()) {
+                thread->join();
+            }
+        }
         exit(-1);
+    };
+
+    // SteamAPI_Init must be called before the video is initialized (the overlay hooks the renderer)
+    {
+        StartupTimeline::Scope scope(&timeline, "steam init");
+        steam->init();
     }
 
+    log("Initializing SDL");
+    {
+        StartupTimeline::Scope scope(&timeline, "SDL_Init");
+        if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS)) {
+            logError("SDL_Init failed: %s", SDL_GetError());
+            exitStartup();
+        }
+    }
+    memStats.milestone("SDL_Init");
+    configThread.join();
+    Config& cfg = *config;
+
     // create window & renderer
     SDL_DisplayMode display;
     SDL_GetCurrentDisplayMode(0, &display);
     log("Screen Resolution: width=%d, height=%d", display.w, display.h);
     SDL_Window* window;
     SDL_Renderer* renderer;
+    auto windowBegin = std::chrono::steady_clock::now();
     if (cfg.graphic.isFullScreen) {
         gpuType |= SDL_WINDOW_FULLSCREEN;
     }
@@ -153,14 +344,16 @@ int main(int argc, char* argv[])
                                         gpuType,
                                         &window,
                                         &renderer)) {
-        log("SDL_CreateWindowAndRenderer failed: %s", SDL_GetError());
-        exit(-1);
+        logError("SDL_CreateWindowAndRenderer failed: %s", SDL_GetError());
+        exitStartup();
     }
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
     SDL_RenderClear(renderer);
     SDL_ShowCursor(SDL_DISABLE);
     SDL_RenderPresent(renderer);
+    timeline.add("window", windowBegin, std::chrono::steady_clock::now());
 
+    auto textureBegin = std::chrono::steady_clock::now();
     double sw = (cfg.graphic.isFullScreen ? display.w : cfg.graphic.windowWidth) / 480.0;
     double sh = (cfg.graphic.isFullScreen ? display.h : cfg.graphic.windowHeight) / 384.0;
     double scale = sw < sh ? sw : sh;
@@ -177,93 +370,78 @@ int main(int argc, char* argv[])
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
     auto texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, frameWidth, frameHeight);
     if (!texture) {
-        log("SDL_CreateTexture failed: %s", SDL_GetError());
-        exit(-1);
+        logError("SDL_CreateTexture failed: %s", SDL_GetError());
+        exitStartup();
     }
     auto frameBuffer = (unsigned int*)malloc(framePitch * frameHeight);
     if (!frameBuffer) {
-        log("No memory");        
-        exit(-1);
+        logError("No memory");
+        exitStartup();
     }
     memset(frameBuffer, 0, framePitch * frameHeight);
-
-    log("Initializing VGS-Zero");
-    int romSize;
-    const void* rom = nullptr;
-    int bgmSize;
-    const void* bgm = nullptr;
-    int seSize;
-    const void* se = nullptr;
-    const unsigned char* ptr = gamepkg;
-    if (0 != memcmp(ptr, "VGS0PKG", 8)) {
-        puts("Invalid package!");
-        return -1;
-    }
-    ptr += 8;
-    memcpy(&romSize, ptr, 4);
-    ptr += 4;
-    rom = ptr;
-    ptr += romSize;
-    printf("- game.rom size: %d\n", romSize);
-    if (romSize < 8 + 8192) {
-        puts("Invalid game.rom size");
-        exit(-1);
+    ImageAtlas images(log);
+    SDL_Rect errJoypadRect;
+    SDL_Texture* errJoypadTexture = nullptr;
+    if (images.open(img_atlas, img_atlas_size)) {
+        errJoypadTexture = createOverlayTexture(renderer, &images, "err_joypad", &errJoypadRect);
+        errJoypadRect.x = (frameWidth - errJoypadRect.w) / 2;
+        errJoypadRect.y = (frameHeight - errJoypadRect.h) / 2;
     }
-    memcpy(&bgmSize, ptr, 4);
-    ptr += 4;
-    bgm = 0 < bgmSize ? ptr : nullptr;
-    ptr += bgmSize;
-    printf("- bgm.dat size: %d\n", bgmSize);
-    memcpy(&seSize, ptr, 4);
-    ptr += 4;
-    se = 0 < seSize ? ptr : nullptr;
-    printf("- se.dat size: %d\n", seSize);
+    timeline.add("texture", textureBegin, std::chrono::steady_clock::now());
+    memStats.milestone("texture");
 
-    VGS0 vgs0;
-    if (0 < bgmSize) {
-        vgs0.loadBgm(bgm, bgmSize);
+    packageThread.join();
+    if (packageError) {
+        logError("Cannot load the package");
+        exitStartup();
     }
-    if (0 < seSize) {
-        vgs0.loadSoundEffect(se, seSize);
-    }
-    vgs0.loadRom(rom, romSize);
     vgs0.setBgmVolume(cfg.sound.volumeBgm);
     vgs0.setSeVolume(cfg.sound.volumeSe);
+    memStats.milestone("VGS-Zero loaded");
 
-    mkdir("save",  S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IWGRP | S_IXGRP | S_IROTH | S_IXOTH | S_IXOTH);
+    saveThread.join();
     vgs0.saveCallback = [](VGS0* vgs0, const void* data, size_t size) -> bool {
-        log("Saving save.dat (%lubytes)", size);
-        FILE* fp = fopen("save/save.dat", "wb");
-        if (!fp) {
-            log("File open error!");
-            return false;
-        }
-        if (size != fwrite(data, 1, size, fp)) {
-            log("File write error!");
-            fclose(fp);
-            return false;
-        }
-        fclose(fp);
-        return true;
+        TRACE_SCOPE("saveCallback");
+        // the file I/O is processed in the writer thread (see savefile.hpp): false while the writes are failing
+        bool result = saveFile->write(data, size);
+        saveRules->check(data, size);
+        return result;
     };
 
     vgs0.loadCallback = [](VGS0* vgs0, void* data, size_t size) -> bool {
+        TRACE_SCOPE("loadCallback");
         log("Loading save.dat (%lubytes)", size);
-        FILE* fp = fopen("save/save.dat", "rb");
-        if (!fp) {
-            log("File open error!");
+        if (!saveFile->read(data, size)) {
+            log("save.dat not found");
             return false;
         }
-        size_t readSize = fread(data, 1, size, fp);
-        if (readSize < size) {
-            log("warning: file size is smaller than expected");
-            memset(&((char*)data)[readSize], 0, size - readSize);
-        }
-        fclose(fp);
+        saveRules->check(data, size);
         return true;
     };
 
+    flightRecorder = new FlightRecorder(log);
+    if (cfg.automation.metrics) {
+        metrics = new Metrics(log);
+        if (metrics->start(cfg.automation.metricsSocket.c_str())) {
+            saveFile->onSaved = [](int64_t latencyUs) { metrics->save(latencyUs); };
+        } else {
+            delete metrics;
+            metrics = nullptr;
+        }
+    }
+
+    if (cfg.automation.control || !cfg.automation.sharedMemory.empty()) {
+        automation = new Automation(log);
+        if (cfg.automation.control) {
+            automation->startControl(cfg.automation.controlSocket.c_str());
+        }
+        if (!cfg.automation.sharedMemory.empty()) {
+            automation->startSharedMemory(cfg.automation.sharedMemory.c_str());
+        }
+    }
+
     log("Initializing AudioDriver");
+    auto audioBegin = std::chrono::steady_clock::now();
     SDL_AudioSpec desired;
     SDL_AudioSpec obtained;
     desired.freq = 44100;
@@ -274,15 +452,29 @@ int main(int argc, char* argv[])
     desired.userdata = &vgs0;
     auto audioDeviceId = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, 0);
     if (0 == audioDeviceId) {
-        log(" ... SDL_OpenAudioDevice failed: %s", SDL_GetError());
+        logError(" ... SDL_OpenAudioDevice failed: %s", SDL_GetError());
         exit(-1);
     }
     log("- obtained.freq = %d", obtained.freq);
     log("- obtained.format = %X", obtained.format);
     log("- obtained.channels = %d", obtained.channels);
     log("- obtained.samples = %d", obtained.samples);
+    audioBytesPerSecond = obtained.freq * obtained.channels * SDL_AUDIO_BITSIZE(obtained.format) / 8;
     SDL_PauseAudioDevice(audioDeviceId, 0);
+    timeline.add("audio", audioBegin, std::chrono::steady_clock::now());
+
+    PackageWatcher packageWatcher(log);
+    std::vector<std::pair<Package*, PackageFile*>> retiredPackages; // may be still referred by VGS0 (see the hot reload)
+    if (packagePath) {
+        packageWatcher.start(packagePath);
+    }
+
+    PerfCounter perf(log);
+    if (perfMode) {
+        perf.open();
+    }
 
+    memStats.milestone("main loop");
     log("Start main loop...");
     SDL_Event event;
     unsigned int loopCount = 0;
@@ -292,19 +484,39 @@ int main(int argc, char* argv[])
     bool joypadConnected = false;
     bool joypadConnectedPrev = false;
     bool detectJoypadDisconnected = false;
+    bool exposed = false;
     unsigned char key1 = 0;
+    PowerState power(log, cfg.power.sleepUnfocused && !automation, !automation, cfg.power.batteryLogInterval); // the automation drives the frames
+    FrameSkip frameSkip(log, cfg.graphic.maxFrameSkip);
 
     while (!halt) {
         auto start = std::chrono::system_clock::now();
         loopCount++;
+        PROBE_FRAME_BEGIN(loopCount);
         if (loopCount % 6 == 0) {
-            SteamAPI_RunCallbacks();
+            TRACE_SCOPE("steam callbacks");
+            auto steamStart = std::chrono::steady_clock::now();
+            steam->runCallbacks();
+            if (metrics) {
+                metrics->steamRunCallbacks(probeElapsedUs(steamStart));
+            }
         }
 
         // Keyboard Input (SDL2)
+        TRACE_BEGIN("events");
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 halt = true;
+            } else if (event.type == SDL_WINDOWEVENT) {
+                switch (event.window.event) {
+                    case SDL_WINDOWEVENT_EXPOSED: exposed = true; break;
+                    case SDL_WINDOWEVENT_FOCUS_GAINED: power.setFocused(true); break;
+                    case SDL_WINDOWEVENT_FOCUS_LOST: power.setFocused(false); break;
+                    case SDL_WINDOWEVENT_MINIMIZED: power.setMinimized(true); break;
+                    case SDL_WINDOWEVENT_HIDDEN: power.setMinimized(true); break;
+                    case SDL_WINDOWEVENT_RESTORED: power.setMinimized(false); break;
+                    case SDL_WINDOWEVENT_SHOWN: power.setMinimized(false); break;
+                }
             } else if (event.type == SDL_KEYDOWN) {
                 if (cfg.keyboard.quit == event.key.keysym.sym) {
                     halt = true;                    
@@ -336,6 +548,7 @@ int main(int argc, char* argv[])
                 if (cfg.keyboard.reset == event.key.keysym.sym) {
                     log("Reset");
                     vgs0.reset();
+                    ramWatch->reset();
                 }
             } else if (event.type == SDL_KEYUP) {
                 if (cfg.keyboard.up == event.key.keysym.sym) {
@@ -364,100 +577,233 @@ int main(int argc, char* argv[])
                 }
             }
         }
+        TRACE_END("events");
         if (halt) {
             break;
         }
 
         // SteamInput
+        TRACE_BEGIN("steam input");
         auto pad1 = steam->getJoypad(&joypadConnected);
+        TRACE_END("steam input");
+        PROBE_JOYPAD_STATE(loopCount, key1, pad1);
+        auto record = flightRecorder->next(loopCount, key1, pad1);
         if (joypadConnected) {
-            if (!joypadConnectedPrev) {
+            if (!joypadConnectedPrev || detectJoypadDisconnected) {
                 log("Joypad Connected!");
             }
             detectJoypadDisconnected = false;
-        } else if (joypadConnectedPrev) {
-            log("Joypad Disconnected! (waiting for resume...)");
-            detectJoypadDisconnected = true;
-            auto fb = frameBuffer;
-            int ox = (frameWidth - 368) / 2;
-            fb += (frameHeight - 48) / 2 * frameWidth;
-            int ptr = 0;
-            for (int y = 0; y < 48; y++, fb += frameWidth) {
-                for (int x = 0; x < 368; x++) {
-                    fb[ox + x] = img_err_joypad[ptr++];
+        } else if (joypadConnectedPrev || detectJoypadDisconnected) {
+            if (!detectJoypadDisconnected) {
+                log("Joypad Disconnected! (waiting for resume...)");
+                detectJoypadDisconnected = true;
+                exposed = true;
+            }
+            if (exposed) {
+                // the last frame is still in the texture: only the overlay is composited
+                exposed = false;
+                SDL_SetRenderTarget(renderer, nullptr);
+                SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+                if (errJoypadTexture) {
+                    SDL_RenderCopy(renderer, errJoypadTexture, nullptr, &errJoypadRect);
                 }
+                SDL_RenderPresent(renderer);
+                timeline.report();
             }
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xff);
-            SDL_UpdateTexture(texture, nullptr, frameBuffer, framePitch);
-            SDL_SetRenderTarget(renderer, nullptr);
-            SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-            SDL_RenderPresent(renderer);
-            usleep(20000);
-            continue;
-        } else if (detectJoypadDisconnected) {
-            usleep(20000);
+            record->flags |= FlightRecorder::FlagJoypadLost;
+            // sleep until an SDL event (key, window or quit) or the timeout, then pump the Steam callbacks (device connection)
+            TRACE_BEGIN("joypad wait");
+            SDL_WaitEventTimeout(nullptr, JOYPAD_WAIT_MS);
+            steam->runCallbacks();
+            TRACE_END("joypad wait");
             continue;
         }
         joypadConnectedPrev = joypadConnected;
 
+        // hot reload of the external package (the window, audio device and Steam session are kept)
+        if (packagePath && 0 == loopCount % 30 && packageWatcher.changed()) {
+            auto newPackageFile = new PackageFile(log);
+            auto newPackage = new Package(log);
+            if (newPackageFile->open(packagePath) && newPackage->open(newPackageFile->getData(), newPackageFile->getSize())) {
+                pthread_mutex_lock(&soundMutex);
+                loadPackage(&vgs0, newPackage);
+                vgs0.reset();
+                pthread_mutex_unlock(&soundMutex);
+                ramWatch->reset();
+                std::swap(package, newPackage);
+                std::swap(packageFile, newPackageFile);
+                log("Reloaded %s", packagePath);
+                // loadPackage keeps the BGM/SE of VGS0 if the new package has none: the old data must stay alive
+                if (0 == package->getSize(Package::Bgm) || 0 == package->getSize(Package::Se)) {
+                    retiredPackages.push_back(std::make_pair(newPackage, newPackageFile));
+                    newPackage = nullptr;
+                    newPackageFile = nullptr;
+                } else {
+                    for (auto& retired : retiredPackages) {
+                        delete retired.first;
+                        delete retired.second;
+                    }
+                    retiredPackages.clear();
+                }
+            } else {
+                logError("Reload failed: continue with the current package");
+            }
+            delete newPackage;
+            delete newPackageFile;
+        }
+
+        // power saving (Steam overlay, unfocused or minimized): no emulation, conversion or upload
+        power.setOverlay(steam->isOverlay());
+        if (power.update() && cfg.power.pauseAudio) {
+            SDL_PauseAudioDevice(audioDeviceId, power.isSaving() ? 1 : 0);
+        }
+        power.logBattery();
+        if (power.isSaving()) {
+            if (PowerState::Overlay == power.get()) {
+                record->flags |= FlightRecorder::FlagOverlay;
+            }
+            if (power.isPresentRequired() || exposed) {
+                // the last frame is still in the texture
+                exposed = false;
+                SDL_SetRenderTarget(renderer, nullptr);
+                SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+                SDL_RenderPresent(renderer);
+                timeline.report();
+            }
+            TRACE_BEGIN("power saving");
+            SDL_WaitEventTimeout(nullptr, power.getWaitMs());
+            steam->runCallbacks();
+            TRACE_END("power saving");
+            continue;
+        }
+
         // execute emulator 1 frame
-        if (!steam->isOverlay()) {
+        if (automation && automation->resetRequested()) {
+            log("Reset (automation)");
+            vgs0.reset();
+            ramWatch->reset();
+        }
+        if (!automation || automation->tickable()) {
+            TRACE_BEGIN("tick");
+            perf.begin();
             pthread_mutex_lock(&soundMutex);
-            vgs0.tick(key1 | pad1);
+            vgs0.tick(automation ? automation->input(key1 | pad1) : key1 | pad1);
             pthread_mutex_unlock(&soundMutex);
+            ramWatch->update(vgs0.ctx.ram);
+            perf.end(PerfCounter::Tick);
+            TRACE_END("tick");
+            record->flags |= FlightRecorder::FlagTick;
+            record->tickUs = (uint32_t)probeElapsedUs(start);
+            FlightRecorder::snapshot(record, vgs0.cpu->reg);
+            if (automation) {
+                automation->ticked(vgs0.getDisplay());
+            }
+            PROBE_TICK_DONE(loopCount, record->tickUs);
             if (vgs0.cpu->reg.IFF & 0x80) {
                 if (0 == (vgs0.cpu->reg.IFF & 0x01)) {
-                    log("Detected the HALT while DI");
+                    logError("Detected the HALT while DI");
+                    if (flightRecorder->dump("HALT while DI")) {
+                        logError("The last frames are recorded in %s", FLIGHT_RECORDER_FILE);
+                    }
                     break;
                 }
             }
         }
 
-        // render graphics
-        auto vgsDisplay = vgs0.getDisplay();
-        auto pcDisplay = (unsigned int*)frameBuffer;
-        pcDisplay += offsetY * frameWidth;
-        for (int y = 0; y < 192; y++) {
-            for (int x = 0; x < 240; x++) {
-                unsigned int rgb555 = vgsDisplay[x];
-                unsigned int rgb888 = 0;
-                rgb888 |= bit5To8((rgb555 & 0b0111110000000000) >> 10);
-                rgb888 <<= 8;
-                rgb888 |= bit5To8((rgb555 & 0b0000001111100000) >> 5);
-                rgb888 <<= 8;
-                rgb888 |= bit5To8(rgb555 & 0b0000000000011111);
-                rgb888 <<= 8;
-                auto offset = offsetX + x * 2;
-                pcDisplay[offset] = rgb888;
-                pcDisplay[offset + 1] = rgb888 & maskTR;
-                pcDisplay[offset + frameWidth] = rgb888 & maskBL;
-                pcDisplay[offset + frameWidth + 1] = rgb888 & maskBR;
+        // render graphics (skipped while the host cannot hold 60fps)
+        int renderUs = -1;
+        if (frameSkip.draw()) {
+            auto renderStart = std::chrono::steady_clock::now();
+            TRACE_BEGIN("convert");
+            perf.begin();
+            auto vgsDisplay = vgs0.getDisplay();
+            auto pcDisplay = (unsigned int*)frameBuffer;
+            pcDisplay += offsetY * frameWidth;
+            for (int y = 0; y < 192; y++) {
+                for (int x = 0; x < 240; x++) {
+                    unsigned int rgb555 = vgsDisplay[x];
+                    unsigned int rgb888 = 0;
+                    rgb888 |= bit5To8((rgb555 & 0b0111110000000000) >> 10);
+                    rgb888 <<= 8;
+                    rgb888 |= bit5To8((rgb555 & 0b0000001111100000) >> 5);
+                    rgb888 <<= 8;
+                    rgb888 |= bit5To8(rgb555 & 0b0000000000011111);
+                    rgb888 <<= 8;
+                    auto offset = offsetX + x * 2;
+                    pcDisplay[offset] = rgb888;
+                    pcDisplay[offset + 1] = rgb888 & maskTR;
+                    pcDisplay[offset + frameWidth] = rgb888 & maskBL;
+                    pcDisplay[offset + frameWidth + 1] = rgb888 & maskBR;
+                }
+                vgsDisplay += 240;
+                pcDisplay += frameWidth * 2;
             }
-            vgsDisplay += 240;
-            pcDisplay += frameWidth * 2;
-        }
+            perf.end(PerfCounter::Convert);
+            TRACE_END("convert");
+            record->convertUs = (uint32_t)probeElapsedUs(start);
 
-        // render display
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xff);
-        SDL_UpdateTexture(texture, nullptr, frameBuffer, framePitch);
-        SDL_SetRenderTarget(renderer, nullptr);
-        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-        SDL_RenderPresent(renderer);
+            // render display
+            TRACE_BEGIN("upload");
+            perf.begin();
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xff);
+            SDL_UpdateTexture(texture, nullptr, frameBuffer, framePitch);
+            perf.end(PerfCounter::Upload);
+            TRACE_END("upload");
+            TRACE_BEGIN("present");
+            SDL_SetRenderTarget(renderer, nullptr);
+            SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+            SDL_RenderPresent(renderer);
+            TRACE_END("present");
+            record->presentUs = (uint32_t)probeElapsedUs(start);
+            PROBE_PRESENT_DONE(loopCount, record->presentUs);
+            timeline.report(); // only the first presented frame is reported (the first loops may wait or skip)
+            renderUs = (int)probeElapsedUs(renderStart);
+        } else {
+            record->flags |= FlightRecorder::FlagSkip;
+        }
+        perf.frame();
+        memStats.frame();
 
         // sync 60fps
         std::chrono::duration<double> diff = std::chrono::system_clock::now() - start;
         int us = (int)(diff.count() * 1000000);
         int wait = waitFps60[loopCount % 3];
-        if (us < wait) {
-            usleep(wait - us);
+        if (metrics) {
+            metrics->frame(us, wait);
+        }
+        int sleepUs = frameSkip.update(us, renderUs, wait);
+        if (0 < sleepUs) {
+            TRACE_SCOPE("sleep");
+            record->waitUs = sleepUs;
+            usleep(sleepUs);
         }
     }
 
+    bool memStatsResult = memStats.finish();
     cfg.save();
+    if (tracePath) {
+        log("Writing %s", tracePath);
+        auto overwritten = Trace::stop();
+        if (overwritten) {
+            log("Trace: %llu old events were overwritten (the buffer keeps the latest %d events per thread)", (unsigned long long)overwritten, TRACE_BUFFER_SIZE);
+        }
+    }
 
     log("Terminating");
+    delete saveFile;
+    delete ramWatch;
+    delete saveRules;
     delete steam;
     SDL_Quit();
+    delete flightRecorder; // after the audio callback is stopped
+    delete metrics;        // after the save writer is stopped
+    delete automation;
+    delete package;     // after the audio callback is stopped
+    delete packageFile;
+    for (auto& retired : retiredPackages) {
+        delete retired.first;
+        delete retired.second;
+    }
     free(frameBuffer);
-    return 0;
+    return memStatsResult ? 0 : 2;
 }
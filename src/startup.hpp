@@ -0,0 +1,95 @@
+/**
+ * VGS-Zero SDK for Steam - Startup timeline (time-to-first-frame breakdown)
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class StartupTimeline
+{
+  private:
+    struct Phase {
+        const char* name;
+        double begin; // ms since the process start
+        double end;
+        bool worker;
+    };
+
+    void (*putlog)(const char*, ...);
+    std::chrono::steady_clock::time_point base;
+    std::thread::id mainThread;
+    std::mutex mutex;
+    std::vector<Phase> phases;
+    bool reported;
+
+    double ms(std::chrono::steady_clock::time_point t)
+    {
+        return std::chrono::duration<double, std::milli>(t - this->base).count();
+    }
+
+  public:
+    /**
+     * Measure the phase until the end of the scope (thread safe)
+     */
+    class Scope
+    {
+      private:
+        StartupTimeline* timeline;
+        const char* name;
+        std::chrono::steady_clock::time_point begin;
+
+      public:
+        Scope(StartupTimeline* timeline, const char* name)
+        {
+            this->timeline = timeline;
+            this->name = name;
+            this->begin = std::chrono::steady_clock::now();
+        }
+
+        ~Scope()
+        {
+            this->timeline->add(this->name, this->begin, std::chrono::steady_clock::now());
+        }
+    };
+
+    StartupTimeline(void (*putlog)(const char*, ...))
+    {
+        this->putlog = putlog;
+        this->base = std::chrono::steady_clock::now();
+        this->mainThread = std::this_thread::get_id();
+        this->reported = false;
+    }
+
+    void add(const char* name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->phases.push_back({name, this->ms(begin), this->ms(end), std::this_thread::get_id() != this->mainThread});
+    }
+
+    /**
+     * Write the breakdown to the log (call once after the first frame is presented)
+     */
+    void report()
+    {
+        if (this->reported) {
+            return;
+        }
+        this->reported = true;
+        double firstFrame = this->ms(std::chrono::steady_clock::now());
+        std::unique_lock<std::mutex> lock(this->mutex);
+        std::sort(this->phases.begin(), this->phases.end(), [](const Phase& a, const Phase& b) { return a.begin < b.begin; });
+        double serial = 0;
+        for (auto& phase : this->phases) {
+            serial += phase.end - phase.begin;
+        }
+        putlog("Time to first frame: %.1fms (sum of the phases: %.1fms)", firstFrame, serial);
+        for (auto& phase : this->phases) {
+            putlog("- %-16s %7.1fms ~ %7.1fms (%6.1fms)%s", phase.name, phase.begin, phase.end, phase.end - phase.begin, phase.worker ? " [worker]" : "");
+        }
+    }
+};
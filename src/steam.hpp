@@ -3,7 +3,23 @@
  * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
  * (C)2024, SUZUKI PLAN
  */
+#pragma once
 #include "../sdk/public/steam/steam_api.h"
+#include "scorequeue.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define STEAM_ACHIEVEMENT_FLUSH_INTERVAL 5
+#define STEAM_ACHIEVEMENT_QUEUE_FILE "achievement_queue.dat"
 
 class CSteam
 {
@@ -19,25 +35,46 @@ class CSteam
     InputDigitalActionHandle_t actStart;
     InputDigitalActionHandle_t actSelect;
     STEAM_CALLBACK_MANUAL(CSteam, onGameOverlayActivated, GameOverlayActivated_t, callbackGameOverlayActivated);
+    STEAM_CALLBACK_MANUAL(CSteam, onUserStatsReceived, UserStatsReceived_t, callbackUserStatsReceived);
+    STEAM_CALLBACK_MANUAL(CSteam, onInputDeviceConnected, SteamInputDeviceConnected_t, callbackInputDeviceConnected);
+    STEAM_CALLBACK_MANUAL(CSteam, onInputDeviceDisconnected, SteamInputDeviceDisconnected_t, callbackInputDeviceDisconnected);
     SteamLeaderboard_t currentLeaderboard;
     void onFindLeaderboard(LeaderboardFindResult_t* callback, bool failed);
     CCallResult<CSteam, LeaderboardFindResult_t> callResultFindLeaderboard;
     void onUploadScore(LeaderboardScoreUploaded_t* callback, bool failed);
     CCallResult<CSteam, LeaderboardScoreUploaded_t> callResultUploadLeaderboardScore;
+    ScoreQueue scoreQueue;
+    std::mutex achievementMutex;
+    std::condition_variable achievementCond;
+    std::thread achievementThread;
+    bool achievementThreadEnd;
+    bool achievementDirty; // the queue is changed after the last write of STEAM_ACHIEVEMENT_QUEUE_FILE
+    bool statsReceived;
+    std::set<std::string> achieved;
+    std::vector<std::string> achievementQueue;
 
   public:
-    CSteam(void (*putlog)(const char*, ...))
+    CSteam(void (*putlog)(const char*, ...)) : scoreQueue(putlog)
     {
         this->putlog = putlog;
         this->initialized = false;
         this->overlay = false;
         this->leaderboardFound = false;
+        this->achievementThreadEnd = false;
+        this->achievementDirty = false;
+        this->statsReceived = false;
         this->deactivate();
     }
 
     ~CSteam()
     {
         if (this->initialized) {
+            {
+                std::unique_lock<std::mutex> lock(this->achievementMutex);
+                this->achievementThreadEnd = true;
+            }
+            this->achievementCond.notify_one();
+            this->achievementThread.join();
             putlog("Teminating Steam...");
             SteamAPI_Shutdown();
         }
@@ -45,17 +82,27 @@ class CSteam
 
     void init(const char* leaderboard = nullptr)
     {
+        if (leaderboard) {
+            this->scoreQueue.start(leaderboard);
+        }
         putlog("Initializing Steam...");
         if (!SteamAPI_Init()) {
             putlog("SteamAPI_Init failed");
         } else {
             this->initialized = true;
+            this->loadAchievementQueue();
+            callbackUserStatsReceived.Register(this, &CSteam::onUserStatsReceived);
             if (!SteamUserStats()->RequestCurrentStats()) {
                 putlog("SteamUserStats::RequestCurrentStats failed!");
             }
+            this->achievementThread = std::thread([this]() { this->achievementMain(); });
             callbackGameOverlayActivated.Register(this, &CSteam::onGameOverlayActivated);
             if (!SteamInput()->Init(true)) {
                 putlog("SteamInput::Init failed!");
+            } else {
+                callbackInputDeviceConnected.Register(this, &CSteam::onInputDeviceConnected);
+                callbackInputDeviceDisconnected.Register(this, &CSteam::onInputDeviceDisconnected);
+                SteamInput()->EnableDeviceCallbacks();
             }
             if (leaderboard) {
                 auto hdl = SteamUserStats()->FindLeaderboard(leaderboard);
@@ -96,31 +143,42 @@ class CSteam
 
     inline bool isOverlay() { return this->overlay; }
 
+    void runCallbacks()
+    {
+        SteamAPI_RunCallbacks();
+        if (this->initialized) {
+            this->uploadScoreQueue();
+        }
+    }
+
     void unlock(const char* name)
     {
         if (!this->initialized) {
             return;
         }
-        if (!SteamUserStats()->SetAchievement(name)) {
-            putlog("SteamUserStats::SetAchievement(%s) failed!", name);
-        } else {
-            if (!SteamUserStats()->StoreStats()) {
-                putlog("SteamUserStats::StoreStats failed!");
+        // the achievement thread commits the queue with a single StoreStats per STEAM_ACHIEVEMENT_FLUSH_INTERVAL seconds
+        std::unique_lock<std::mutex> lock(this->achievementMutex);
+        if (this->achieved.count(name)) {
+            return;
+        }
+        for (auto& queued : this->achievementQueue) {
+            if (queued == name) {
+                return;
             }
         }
+        this->achievementQueue.push_back(name);
+        this->achievementDirty = true;
+        this->achievementCond.notify_one();
     }
 
     void sendScore(int score)
     {
-        if (!this->initialized) {
-            return;
-        }
-        if (!this->leaderboardFound) {
-            putlog("Score was not send to the leadboard (leadboard not found)");
+        if (!this->scoreQueue.isStarted()) {
+            putlog("Score was not send to the leadboard (leadboard not specified)");
             return;
         }
-        auto hdl = SteamUserStats()->UploadLeaderboardScore(this->currentLeaderboard, k_ELeaderboardUploadScoreMethodKeepBest, score, nullptr, 0);
-        this->callResultUploadLeaderboardScore.Set(hdl, this, &CSteam::onUploadScore);
+        // queued and persisted without blocking (sent in runCallbacks within the rate limit)
+        this->scoreQueue.push(score);
     }
 
   private:
@@ -174,15 +232,170 @@ class CSteam
         }
         return true;
     }
+
+    void achievementMain()
+    {
+        auto flushTime = std::chrono::steady_clock::now() + std::chrono::seconds(STEAM_ACHIEVEMENT_FLUSH_INTERVAL);
+        std::unique_lock<std::mutex> lock(this->achievementMutex);
+        while (true) {
+            this->achievementCond.wait_until(lock, flushTime, [this]() { return this->achievementThreadEnd || this->achievementDirty; });
+            bool end = this->achievementThreadEnd;
+            // persist the queue at once: the unlocks survive a crash before the StoreStats (or a session without the user stats)
+            if (this->achievementDirty) {
+                this->saveAchievementQueue(lock);
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (!end && now < flushTime) {
+                continue;
+            }
+            flushTime = now + std::chrono::seconds(STEAM_ACHIEVEMENT_FLUSH_INTERVAL);
+            // wait for RequestCurrentStats to dedupe the queue (except at the shutdown)
+            if (!this->achievementQueue.empty() && (this->statsReceived || end)) {
+                std::vector<std::string> queue;
+                queue.swap(this->achievementQueue);
+                lock.unlock();
+                auto failed = this->storeAchievements(queue);
+                lock.lock();
+                // only the unlocked names are settled: the failed ones stay in the persisted queue and are retried
+                for (auto& name : queue) {
+                    if (std::find(failed.begin(), failed.end(), name) == failed.end()) {
+                        this->achieved.insert(name);
+                    } else if (std::find(this->achievementQueue.begin(), this->achievementQueue.end(), name) == this->achievementQueue.end()) {
+                        this->achievementQueue.push_back(name);
+                    }
+                }
+                this->saveAchievementQueue(lock);
+            }
+            if (end) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * Returns the achievements to retry (SetAchievement fails until the user stats are received)
+     */
+    std::vector<std::string> storeAchievements(const std::vector<std::string>& queue)
+    {
+        std::vector<std::string> failed;
+        bool changed = false;
+        for (auto& name : queue) {
+            bool achieved = false;
+            if (SteamUserStats()->GetAchievement(name.c_str(), &achieved) && achieved) {
+                continue;
+            }
+            if (!SteamUserStats()->SetAchievement(name.c_str())) {
+                putlog("SteamUserStats::SetAchievement(%s) failed!", name.c_str());
+                failed.push_back(name);
+            } else {
+                putlog("Achievement unlocked: %s", name.c_str());
+                changed = true;
+            }
+        }
+        if (changed && !SteamUserStats()->StoreStats()) {
+            putlog("SteamUserStats::StoreStats failed!");
+        }
+        return failed;
+    }
+
+    void loadAchievementQueue()
+    {
+        FILE* fp = fopen(STEAM_ACHIEVEMENT_QUEUE_FILE, "rt");
+        if (!fp) {
+            return;
+        }
+        char name[256];
+        std::unique_lock<std::mutex> lock(this->achievementMutex);
+        while (fgets(name, sizeof(name), fp)) {
+            name[strcspn(name, "\r\n")] = 0;
+            if (name[0]) {
+                this->achievementQueue.push_back(name);
+            }
+        }
+        fclose(fp);
+        putlog("Pending achievements found: %d", (int)this->achievementQueue.size());
+    }
+
+    // called with the achievementMutex locked (unlocked while writing the file)
+    void saveAchievementQueue(std::unique_lock<std::mutex>& lock)
+    {
+        this->achievementDirty = false;
+        auto queue = this->achievementQueue;
+        lock.unlock();
+        if (queue.empty()) {
+            remove(STEAM_ACHIEVEMENT_QUEUE_FILE);
+        } else {
+            FILE* fp = fopen(STEAM_ACHIEVEMENT_QUEUE_FILE, "wt");
+            if (!fp) {
+                putlog("Cannot save the pending achievements!");
+            } else {
+                for (auto& name : queue) {
+                    fprintf(fp, "%s\n", name.c_str());
+                }
+                fclose(fp);
+            }
+        }
+        lock.lock();
+    }
+
+    void uploadScoreQueue()
+    {
+        int score;
+        if (!this->leaderboardFound || !this->scoreQueue.pop(std::chrono::steady_clock::now(), &score)) {
+            return;
+        }
+        auto hdl = SteamUserStats()->UploadLeaderboardScore(this->currentLeaderboard, k_ELeaderboardUploadScoreMethodKeepBest, score, nullptr, 0);
+        this->callResultUploadLeaderboardScore.Set(hdl, this, &CSteam::onUploadScore);
+    }
 };
 
 void CSteam::onGameOverlayActivated(GameOverlayActivated_t* args)
 {
+    TRACE_SCOPE("steam: GameOverlayActivated");
     this->overlay = args->m_bActive;
 }
 
+void CSteam::onInputDeviceConnected(SteamInputDeviceConnected_t* args)
+{
+    TRACE_SCOPE("steam: SteamInputDeviceConnected");
+    putlog("SteamInput device connected: %llX", (unsigned long long)args->m_ulConnectedDeviceHandle);
+}
+
+void CSteam::onInputDeviceDisconnected(SteamInputDeviceDisconnected_t* args)
+{
+    TRACE_SCOPE("steam: SteamInputDeviceDisconnected");
+    putlog("SteamInput device disconnected: %llX", (unsigned long long)args->m_ulDisconnectedDeviceHandle);
+}
+
+void CSteam::onUserStatsReceived(UserStatsReceived_t* args)
+{
+    TRACE_SCOPE("steam: UserStatsReceived");
+    if (args->m_nGameID != SteamUtils()->GetAppID()) {
+        return;
+    }
+    if (k_EResultOK != args->m_eResult) {
+        putlog("onUserStatsReceived: failed (%d)", (int)args->m_eResult);
+        return;
+    }
+    // the Steam API is called without the achievementMutex (the achievement thread may be in StoreStats)
+    std::set<std::string> achieved;
+    uint32_t num = SteamUserStats()->GetNumAchievements();
+    for (uint32_t i = 0; i < num; i++) {
+        const char* name = SteamUserStats()->GetAchievementName(i);
+        bool result = false;
+        if (name && SteamUserStats()->GetAchievement(name, &result) && result) {
+            achieved.insert(name);
+        }
+    }
+    std::unique_lock<std::mutex> lock(this->achievementMutex);
+    this->achieved.insert(achieved.begin(), achieved.end());
+    this->statsReceived = true;
+    putlog("User stats received: %d of %u achievements unlocked", (int)achieved.size(), num);
+}
+
 void CSteam::onFindLeaderboard(LeaderboardFindResult_t* callback, bool failed)
 {
+    TRACE_SCOPE("steam: LeaderboardFindResult");
     if (failed || !callback || !callback->m_bLeaderboardFound) {
         putlog("onFindLeaderboard: leaderboard not found or error");
     } else {
@@ -194,11 +407,14 @@ void CSteam::onFindLeaderboard(LeaderboardFindResult_t* callback, bool failed)
 
 void CSteam::onUploadScore(LeaderboardScoreUploaded_t* callback, bool failed)
 {
+    TRACE_SCOPE("steam: LeaderboardScoreUploaded");
     if (failed || !callback || !callback->m_bSuccess) {
-        putlog("onUploadScore: cannot register to the leaderboard");
+        putlog("onUploadScore: cannot register to the leaderboard (retry later)");
+        this->scoreQueue.uploaded(false);
     } else {
         if (callback->m_bScoreChanged) {
             putlog("score: %d, ranking: %d -> %d", callback->m_nScore, callback->m_nGlobalRankPrevious, callback->m_nGlobalRankNew);
         }
+        this->scoreQueue.uploaded(true);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,165 @@
+/**
+ * VGS-Zero SDK for Steam - Chrome Trace Event recorder (open the output with Perfetto or about:tracing)
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#define TRACE_BUFFER_SIZE 0x40000 // events per thread (ring: the latest events are kept, must be power of 2)
+
+#ifdef __GNUC__
+#define TRACE_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define TRACE_UNLIKELY(x) (x)
+#endif
+
+// the disabled cost is a single predictable branch (relaxed load)
+#define TRACE_BEGIN(name)                                                         \
+    do {                                                                          \
+        if (TRACE_UNLIKELY(Trace::enabled.load(std::memory_order_relaxed))) {     \
+            Trace::record(name, 'B');                                             \
+        }                                                                         \
+    } while (0)
+#define TRACE_END(name)                                                           \
+    do {                                                                          \
+        if (TRACE_UNLIKELY(Trace::enabled.load(std::memory_order_relaxed))) {     \
+            Trace::record(name, 'E');                                             \
+        }                                                                         \
+    } while (0)
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+class Trace
+{
+  private:
+    struct Event {
+        const char* name; // must be a string literal
+        int64_t ns;
+        char phase;
+    };
+
+    struct Buffer {
+        int tid;
+        const char* threadName;
+        std::atomic<uint32_t> count; // total recorded events (events[count % TRACE_BUFFER_SIZE] is the next)
+        Event events[TRACE_BUFFER_SIZE];
+    };
+
+    static std::chrono::steady_clock::time_point base;
+    static std::mutex mutex;
+    static std::vector<Buffer*> buffers;
+    static FILE* fp;
+
+    static Buffer* buffer(const char* threadName = nullptr)
+    {
+        static thread_local Buffer* tls = nullptr;
+        if (!tls) {
+            std::unique_lock<std::mutex> lock(mutex);
+            tls = new Buffer();
+            tls->tid = (int)buffers.size() + 1;
+            tls->threadName = threadName;
+            tls->count.store(0, std::memory_order_relaxed);
+            buffers.push_back(tls);
+        } else if (threadName) {
+            tls->threadName = threadName;
+        }
+        return tls;
+    }
+
+  public:
+    static std::atomic<bool> enabled;
+
+    static bool start(const char* path)
+    {
+        fp = fopen(path, "wt");
+        if (!fp) {
+            return false;
+        }
+        base = std::chrono::steady_clock::now();
+        enabled.store(true, std::memory_order_release);
+        return true;
+    }
+
+    static void setThreadName(const char* name)
+    {
+        if (enabled.load(std::memory_order_relaxed)) {
+            buffer(name);
+        }
+    }
+
+    static void record(const char* name, char phase)
+    {
+        auto buf = buffer();
+        uint32_t index = buf->count.load(std::memory_order_relaxed);
+        auto& event = buf->events[index & (TRACE_BUFFER_SIZE - 1)]; // overwrite the oldest event if full
+        event.name = name;
+        event.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - base).count();
+        event.phase = phase;
+        buf->count.store(index + 1, std::memory_order_release);
+    }
+
+    /**
+     * Write the recorded events as the Chrome Trace Event format
+     * Returns the number of the old events overwritten in the ring buffers (not written)
+     */
+    static uint64_t stop()
+    {
+        if (!enabled.exchange(false, std::memory_order_acq_rel)) {
+            return 0;
+        }
+        uint64_t overwritten = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (auto buf : buffers) {
+            if (buf->threadName) {
+                fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", buf->tid, buf->threadName);
+                first = false;
+            }
+            uint32_t count = buf->count.load(std::memory_order_acquire);
+            // a full ring skips the oldest slot: a record in progress (checked enabled before the stop) may overwrite it
+            uint32_t begin = TRACE_BUFFER_SIZE <= count ? count - TRACE_BUFFER_SIZE + 1 : 0;
+            overwritten += begin;
+            for (uint32_t i = begin; i < count; i++) {
+                auto& event = buf->events[i & (TRACE_BUFFER_SIZE - 1)];
+                fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", first ? "" : ",\n", event.name, event.phase, event.ns / 1000.0, buf->tid);
+                first = false;
+            }
+        }
+        fprintf(fp, "\n]}\n");
+        fclose(fp);
+        fp = nullptr;
+        return overwritten;
+    }
+};
+
+std::chrono::steady_clock::time_point Trace::base;
+std::mutex Trace::mutex;
+std::vector<Trace::Buffer*> Trace::buffers;
+FILE* Trace::fp = nullptr;
+std::atomic<bool> Trace::enabled(false);
+
+class TraceScope
+{
+  private:
+    const char* name;
+
+  public:
+    TraceScope(const char* name)
+    {
+        this->name = name;
+        TRACE_BEGIN(name);
+    }
+
+    ~TraceScope()
+    {
+        TRACE_END(this->name);
+    }
+};
@@ -12,7 +12,11 @@
 
 #include "inputmgr.hpp"
 #include "keyconfig.hpp"
+#include "logger.hpp"
+#include "package.hpp"
 
+#include "ramwatch.hpp"
+#include "saverules.hpp"
 #include "steam.hpp"
 
 #include <Windows.h>
@@ -101,29 +105,21 @@ static CRITICAL_SECTION _lock;
 static InputManager _im(putlog);
 static std::vector<KeyConfig*> _kbConfig;
 static VGS0 vgs0(VDP::ColorMode::RGB555);
-static unsigned char _saveData[0x4000];
-static size_t _saveSize = 0;
 static CSteam* steam;
+static SaveRules* saveRules;
+static RamWatch* ramWatch;
+
+static Logger* _logger = nullptr;
 
 static void putlog(const char* msg, ...)
 {
-    FILE* fp;
-    va_list args;
-    time_t t1;
-    struct tm* t2;
-
-    CreateDirectoryA("save", nullptr);
-    if (NULL == (fp = fopen("log.txt", "a"))) {
+    if (!_logger) {
         return;
     }
-    t1 = time(NULL);
-    t2 = localtime(&t1);
-    fprintf(fp, "%04d/%02d/%02d %02d:%02d:%02d ", t2->tm_year + 1900, t2->tm_mon + 1, t2->tm_mday, t2->tm_hour, t2->tm_min, t2->tm_sec);
+    va_list args;
     va_start(args, msg);
-    vfprintf(fp, msg, args);
+    _logger->vprint(Logger::Level::Info, msg, args);
     va_end(args);
-    fprintf(fp, "\n");
-    fclose(fp);
 }
 
 static void save_config()
@@ -218,6 +214,12 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     UNREFERENCED_PARAMETER(lpCmdLine);
 
     DeleteFileA("log.txt");
+    CreateDirectoryA("save", nullptr);
+    _logger = new Logger();
+    atexit([]() {
+        // not deleted: the threads that are still running (e.g. the achievement thread) may call putlog
+        _logger->shutdown();
+    });
 
     putlog("Loading config.json");
     reset_keyboard_assign();
@@ -320,6 +322,10 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
     steam = new CSteam(putlog);
     steam->init();
+    saveRules = new SaveRules(putlog, steam);
+    saveRules->load();
+    ramWatch = new RamWatch(putlog, steam);
+    ramWatch->load();
 
     putlog("Initializing Window...");
     MyRegisterClass(hInstance);
@@ -328,28 +334,21 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     }
 
     putlog("Initializing VGS-Zero emulator...");
-    const void* rom = nullptr;
-    const void* bgm = nullptr;
-    const void* se = nullptr;
-    unsigned int romSize = 0;
-    unsigned int bgmSize = 0;
-    unsigned int seSize = 0;
+    static Package package(putlog);
     {
         HRSRC gamepkg = FindResource(0, MAKEINTRESOURCE(IDR_GAMEPKG), TEXT("BIN"));
         const BYTE* ptr = (const BYTE*)LockResource(LoadResource(0, gamepkg));
-        ptr += 8;
-        memcpy(&romSize, ptr, 4);
-        ptr += 4;
-        rom = ptr;
-        ptr += romSize;
-        memcpy(&bgmSize, ptr, 4);
-        ptr += 4;
-        bgm = 0 < bgmSize ? ptr : nullptr;
-        ptr += bgmSize;
-        memcpy(&seSize, ptr, 4);
-        ptr += 4;
-        se = 0 < seSize ? ptr : nullptr;
+        if (!ptr || !package.open(ptr, SizeofResource(0, gamepkg))) {
+            MessageBoxA(nullptr, "Cannot load the package", "Error", MB_OK | MB_ICONERROR);
+            return FALSE;
+        }
     }
+    const void* rom = package.get(Package::Rom);
+    const void* bgm = package.get(Package::Bgm);
+    const void* se = package.get(Package::Se);
+    unsigned int romSize = (unsigned int)package.getSize(Package::Rom);
+    unsigned int bgmSize = (unsigned int)package.getSize(Package::Bgm);
+    unsigned int seSize = (unsigned int)package.getSize(Package::Se);
     putlog("Loading ROM (%u banks = %u bytes)", romSize / 8192 + 1, romSize);
     vgs0.loadRom(rom, romSize);
     if (0 < bgmSize) {
@@ -370,6 +369,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
             return false;
         bool result = size == fwrite(data, 1, size, fp);
         fclose(fp);
+        saveRules->check(data, size);
         return result;
     };
     vgs0.loadCallback = [](VGS0* vgs0, void* data, size_t size) -> bool {
@@ -378,7 +378,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
             return false;
         bool result = size = fread(data, 1, size, fp);
         fclose(fp);
-        memcpy(_saveData, data, size & 0x3FFF);
+        saveRules->check(data, size);
         return result;
     };
 
@@ -445,7 +445,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
             }
         }
         if (loopCounter % 6 == 0) {
-            SteamAPI_RunCallbacks();
+            steam->runCallbacks();
         }
         if (need_restore) {
             putlog("Detected need restart message.");
@@ -487,6 +487,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
             lock();
             vgs0.tick(pad);
             unlock();
+            ramWatch->update(vgs0.ctx.ram);
         }
 
         if (vgs0.cpu->reg.IFF & 0x80) {
@@ -548,6 +549,8 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     save_config();
     term_sound();
     gterm();
+    delete ramWatch;
+    delete saveRules;
     delete steam;
     putlog("The all of resources are released");
 
@@ -627,6 +630,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             switch (wmId) {
                 case IDM_RESET:
                     vgs0.reset();
+                    ramWatch->reset();
                     break;
                 case IDM_EXIT:
                     DestroyWindow(hWnd);
@@ -0,0 +1,83 @@
+/**
+ * VGS-Zero SDK for Steam - Test of the offset and size checks of achievement.json
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+// steam.hpp uses the joypad bits of vgs0.hpp (not used by the test)
+#define VGS0_JOYPAD_UP 0x80
+#define VGS0_JOYPAD_DW 0x40
+#define VGS0_JOYPAD_LE 0x20
+#define VGS0_JOYPAD_RI 0x10
+#define VGS0_JOYPAD_ST 0x08
+#define VGS0_JOYPAD_SE 0x04
+#define VGS0_JOYPAD_T1 0x02
+#define VGS0_JOYPAD_T2 0x01
+#include "../src/saverules.hpp"
+#include <stdarg.h>
+
+#define TEST_FILE "saverules_test.json"
+
+static int failures = 0;
+static std::vector<std::string> logs;
+
+#define CHECK(expr)                                                      \
+    if (!(expr)) {                                                       \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+        failures++;                                                      \
+    }
+
+static void putlog(const char* format, ...)
+{
+    char buf[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    puts(buf);
+    logs.push_back(buf);
+}
+
+static int countLogs(const char* prefix)
+{
+    int result = 0;
+    for (auto& line : logs) {
+        result += 0 == line.compare(0, strlen(prefix), prefix) ? 1 : 0;
+    }
+    return result;
+}
+
+static void testOffset()
+{
+    FILE* fp = fopen(TEST_FILE, "wt");
+    fputs("{\"achievements\": [\n"
+          "  {\"id\": \"WRAP\", \"offset\": \"0xFFFFFFFF\", \"size\": 1},\n"
+          "  {\"id\": \"WRAP4\", \"offset\": \"0xFFFFFFFC\", \"size\": 4},\n"
+          "  {\"id\": \"HUGE\", \"offset\": 1000000, \"size\": 2},\n"
+          "  {\"id\": \"END\", \"offset\": \"0x4000\", \"size\": 1},\n"
+          "  {\"id\": \"ACROSS\", \"offset\": \"0x3FFE\", \"size\": 4},\n"
+          "  {\"id\": \"LAST\", \"offset\": \"0x3FFC\", \"size\": 4},\n"
+          "  {\"id\": \"FIRST\", \"offset\": 0, \"size\": 1}\n"
+          "]}\n",
+          fp);
+    fclose(fp);
+    logs.clear();
+    SaveRules rules(putlog, nullptr); // no rule fires on the zero filled data (compare: != 0)
+    CHECK(rules.load(TEST_FILE));
+    CHECK(5 == countLogs("- invalid offset"));
+    CHECK(1 == countLogs("- 2 rules (2 achievements)"));
+    std::vector<unsigned char> data(SAVE_RULES_MAX_SIZE);
+    rules.check(data.data(), data.size());
+    rules.check(data.data(), data.size());
+    remove(TEST_FILE);
+}
+
+int main()
+{
+    testOffset();
+    if (failures) {
+        printf("FAILED (%d)\n", failures);
+        return 1;
+    }
+    puts("OK");
+    return 0;
+}
@@ -0,0 +1,216 @@
+/**
+ * VGS-Zero SDK for Steam - Test of the leaderboard upload queue against a local Steam stand-in
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ */
+#include "../src/scorequeue.hpp"
+#include <deque>
+#include <stdarg.h>
+#include <vector>
+
+#define TEST_FILE "scorequeue_test.dat"
+#define STEAM_LIMIT_COUNT 10
+#define STEAM_LIMIT_SECONDS 600
+
+static int failures = 0;
+
+#define CHECK(expr)                                                      \
+    if (!(expr)) {                                                       \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+        failures++;                                                      \
+    }
+
+static void putlog(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stdout, format, args);
+    va_end(args);
+    fprintf(stdout, "\n");
+}
+
+// stand-in of the Steam leaderboard: the upload completes after the latency (in the simulated time)
+class SteamStandIn
+{
+  public:
+    struct Request {
+        double time;
+        int score;
+    };
+    std::vector<Request> uploads;
+    std::deque<Request> inFlight;
+    int best = 0;
+    int failEvery = 0; // fail every N uploads (0: never)
+
+    void upload(double now, int score)
+    {
+        this->uploads.push_back({now, score});
+        this->inFlight.push_back({now + 0.5, score});
+    }
+
+    // runCallbacks: returns true if an upload completed (result: succeeded or failed)
+    bool complete(double now, bool* result)
+    {
+        if (this->inFlight.empty() || now < this->inFlight.front().time) {
+            return false;
+        }
+        auto request = this->inFlight.front();
+        this->inFlight.pop_front();
+        *result = !(this->failEvery && 0 == this->uploads.size() % this->failEvery);
+        if (*result && this->best < request.score) {
+            this->best = request.score;
+        }
+        return true;
+    }
+
+    // the most uploads in any STEAM_LIMIT_SECONDS window
+    int maxUploadsInWindow()
+    {
+        int result = 0;
+        for (size_t i = 0; i < this->uploads.size(); i++) {
+            int count = 0;
+            for (size_t j = i; j < this->uploads.size() && this->uploads[j].time <= this->uploads[i].time + STEAM_LIMIT_SECONDS; j++) {
+                count++;
+            }
+            result = result < count ? count : result;
+        }
+        return result;
+    }
+};
+
+// run the game loop at 60fps for the seconds (scoreAt: the score sent in the frame, or negative)
+template <typename F>
+static void run(ScoreQueue& queue, SteamStandIn& steam, double* now, double seconds, F scoreAt)
+{
+    auto base = ScoreQueue::Clock::time_point();
+    for (double end = *now + seconds; *now < end; *now += 1.0 / 60) {
+        int score = scoreAt(*now);
+        if (0 <= score) {
+            queue.push(score);
+        }
+        bool result;
+        if (steam.complete(*now, &result)) {
+            queue.uploaded(result);
+        }
+        auto clock = base + std::chrono::duration_cast<ScoreQueue::Clock::duration>(std::chrono::duration<double>(*now));
+        if (queue.pop(clock, &score)) {
+            steam.upload(*now, score);
+        }
+    }
+}
+
+static void testFlood()
+{
+    remove(TEST_FILE);
+    ScoreQueue queue(putlog, TEST_FILE);
+    queue.start("Flood Test");
+    SteamStandIn steam;
+    double now = 0;
+    int score = 0;
+    // flood: a new best score in every frame for 2 hours
+    run(queue, steam, &now, 7200, [&](double) { return ++score; });
+    printf("flood: %d calls -> %d uploads (max %d in %d seconds)\n", score, (int)steam.uploads.size(), steam.maxUploadsInWindow(), STEAM_LIMIT_SECONDS);
+    CHECK(steam.maxUploadsInWindow() <= STEAM_LIMIT_COUNT);
+    CHECK(SCORE_QUEUE_BURST <= (int)steam.uploads.size());
+    for (size_t i = 1; i < steam.uploads.size(); i++) {
+        CHECK(steam.uploads[i - 1].score < steam.uploads[i].score);
+    }
+    // the best score is sent after the flood
+    run(queue, steam, &now, SCORE_QUEUE_INTERVAL * 2, [](double) { return -1; });
+    CHECK(score == steam.best);
+    CHECK(steam.maxUploadsInWindow() <= STEAM_LIMIT_COUNT);
+}
+
+static void testRetry()
+{
+    remove(TEST_FILE);
+    ScoreQueue queue(putlog, TEST_FILE);
+    queue.start("Retry Test");
+    SteamStandIn steam;
+    steam.failEvery = 2;
+    double now = 0;
+    int score = 0;
+    run(queue, steam, &now, 3600, [&](double t) { return (int)t % 7 ? -1 : ++score; });
+    run(queue, steam, &now, SCORE_QUEUE_INTERVAL * 4, [](double) { return -1; });
+    printf("retry: %d uploads, best %d/%d (max %d in %d seconds)\n", (int)steam.uploads.size(), steam.best, score, steam.maxUploadsInWindow(), STEAM_LIMIT_SECONDS);
+    CHECK(score == steam.best);
+    CHECK(steam.maxUploadsInWindow() <= STEAM_LIMIT_COUNT);
+}
+
+static void testPersistence()
+{
+    remove(TEST_FILE);
+    {
+        ScoreQueue queue(putlog, TEST_FILE);
+        queue.start("Name With Spaces");
+        queue.push(100);
+        queue.push(50); // not the best
+        queue.push(300);
+    } // quit before the upload: the writer thread writes the pending score
+    {
+        ScoreQueue queue(putlog, TEST_FILE);
+        queue.start("Name With Spaces");
+        int score = 0;
+        CHECK(queue.pop(ScoreQueue::Clock::now(), &score));
+        CHECK(300 == score);
+        queue.uploaded(true);
+    }
+    {
+        ScoreQueue queue(putlog, TEST_FILE);
+        queue.start("Name With Spaces"); // the uploaded score is not sent again
+        int score = 0;
+        CHECK(!queue.pop(ScoreQueue::Clock::now(), &score));
+        queue.push(400);
+        CHECK(queue.pop(ScoreQueue::Clock::now(), &score));
+        CHECK(400 == score);
+        queue.uploaded(true);
+    }
+    {
+        ScoreQueue queue(putlog, TEST_FILE);
+        queue.start("Other Leaderboard");
+        queue.push(1);
+    }
+    {
+        ScoreQueue queue(putlog, TEST_FILE);
+        queue.start("Name With Spaces"); // the score of the other leaderboard is not loaded
+        int score = 0;
+        CHECK(!queue.pop(ScoreQueue::Clock::now(), &score));
+    }
+    remove(TEST_FILE);
+}
+
+static void testRestart()
+{
+    remove(TEST_FILE);
+    // use up the burst, then restart the game: the bucket is not refilled by the restart
+    for (int launch = 0; launch < 3; launch++) {
+        ScoreQueue queue(putlog, TEST_FILE);
+        queue.start("Restart Test");
+        int uploads = 0;
+        for (int i = 0; i < SCORE_QUEUE_BURST * 2; i++) {
+            int score = 0;
+            queue.push(launch * 100 + i + 1);
+            if (queue.pop(ScoreQueue::Clock::now(), &score)) {
+                queue.uploaded(true);
+                uploads++;
+            }
+        }
+        printf("restart: launch %d -> %d uploads\n", launch, uploads);
+        CHECK((0 == launch ? SCORE_QUEUE_BURST : 0) == uploads);
+    }
+    remove(TEST_FILE);
+}
+
+int main()
+{
+    testFlood();
+    testRetry();
+    testPersistence();
+    testRestart();
+    if (failures) {
+        printf("FAILED (%d)\n", failures);
+        return 1;
+    }
+    puts("OK");
+    return 0;
+}
@@ -0,0 +1,124 @@
+/**
+ * VGS-Zero SDK for Steam - Offline stand-in of the Steamworks API used by steam.hpp (for the tests without the Steam SDK)
+ * License under GPLv3: https://github.com/suzukiplan/vgszero/blob/master/LICENSE-VGS0.txt
+ * (C)2024, SUZUKI PLAN
+ *
+ * The functions do nothing (the Steam client is offline): steam.hpp is compiled and linked without the Steam API library.
+ */
+#pragma once
+#include <stdint.h>
+
+typedef uint64_t InputActionSetHandle_t;
+typedef uint64_t InputAnalogActionHandle_t;
+typedef uint64_t InputDigitalActionHandle_t;
+typedef uint64_t InputHandle_t;
+typedef uint64_t SteamLeaderboard_t;
+typedef uint64_t SteamAPICall_t;
+#define STEAM_INPUT_MAX_COUNT 16
+
+struct InputDigitalActionData_t {
+    bool bState;
+    bool bActive;
+};
+
+struct InputAnalogActionData_t {
+    float x;
+    float y;
+};
+
+enum ELeaderboardUploadScoreMethod {
+    k_ELeaderboardUploadScoreMethodKeepBest = 1,
+};
+
+enum EResult {
+    k_EResultOK = 1,
+    k_EResultFail = 2,
+};
+
+struct ISteamUserStats {
+    bool RequestCurrentStats() { return false; }
+    bool SetAchievement(const char* name) { return false; }
+    bool StoreStats() { return false; }
+    bool GetAchievement(const char* name, bool* achieved) { return false; }
+    uint32_t GetNumAchievements() { return 0; }
+    const char* GetAchievementName(uint32_t index) { return nullptr; }
+    SteamAPICall_t FindLeaderboard(const char* name) { return 0; }
+    SteamAPICall_t UploadLeaderboardScore(SteamLeaderboard_t leaderboard, ELeaderboardUploadScoreMethod method, int32_t score, const int32_t* details, int detailsCount) { return 0; }
+};
+
+struct ISteamInput {
+    bool Init(bool explicitlyCallRunFrame) { return false; }
+    void RunFrame() {}
+    int GetConnectedControllers(InputHandle_t* handles) { return 0; }
+    InputActionSetHandle_t GetActionSetHandle(const char* name) { return 0; }
+    InputDigitalActionHandle_t GetDigitalActionHandle(const char* name) { return 0; }
+    InputAnalogActionHandle_t GetAnalogActionHandle(const char* name) { return 0; }
+    InputDigitalActionData_t GetDigitalActionData(InputHandle_t input, InputDigitalActionHandle_t action) { return {}; }
+    InputAnalogActionData_t GetAnalogActionData(InputHandle_t input, InputAnalogActionHandle_t action) { return {}; }
+    void EnableDeviceCallbacks() {}
+};
+
+struct ISteamUtils {
+    uint32_t GetAppID() { return 0; }
+};
+
+inline ISteamUserStats* SteamUserStats() { return nullptr; }
+inline ISteamInput* SteamInput() { return nullptr; }
+inline ISteamUtils* SteamUtils() { return nullptr; }
+inline bool SteamAPI_Init() { return false; }
+inline void SteamAPI_Shutdown() {}
+inline void SteamAPI_RunCallbacks() {}
+
+struct GameOverlayActivated_t {
+    uint8_t m_bActive;
+};
+
+struct UserStatsReceived_t {
+    uint64_t m_nGameID;
+    EResult m_eResult;
+};
+
+struct UserStatsStored_t {
+    uint64_t m_nGameID;
+    EResult m_eResult;
+};
+
+struct SteamInputDeviceConnected_t {
+    InputHandle_t m_ulConnectedDeviceHandle;
+};
+
+struct SteamInputDeviceDisconnected_t {
+    InputHandle_t m_ulDisconnectedDeviceHandle;
+};
+
+struct LeaderboardFindResult_t {
+    SteamLeaderboard_t m_hSteamLeaderboard;
+    uint8_t m_bLeaderboardFound;
+};
+
+struct LeaderboardScoreUploaded_t {
+    uint8_t m_bSuccess;
+    SteamLeaderboard_t m_hSteamLeaderboard;
+    int32_t m_nScore;
+    uint8_t m_bScoreChanged;
+    int m_nGlobalRankNew;
+    int m_nGlobalRankPrevious;
+};
+
+template <class T, class P>
+struct CCallResult {
+    void Set(SteamAPICall_t call, T* object, void (T::*func)(P*, bool)) {}
+    bool IsActive() const { return false; }
+    void Cancel() {}
+};
+
+template <class T, class P>
+struct CCallbackManual {
+    void Register(T* object, void (T::*func)(P*)) {}
+    void Unregister() {}
+};
+
+#define STEAM_CALLBACK_MANUAL(thisclass, func, param, var) \
+    CCallbackManual<thisclass, param> var;                 \
+    void func(param* pParam)
+